@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <svg/svg.hpp>
+
+// Ellipse drawn as before the incremental rasterizer, kept for
+// comparison: a square root and a search per row.
+void sqrt_ellipse(svg::png_image& img, const svg::point& center, int rx, int ry,
+                  const svg::color& fill) {
+    auto inside = [&](int x, double vy) {
+        double vx = (double) x / (double) rx;
+        return vx * vx + vy <= 1;
+    };
+    for (int y = -ry; y <= ry; y++) {
+        int w = rx;
+        if (y != 0) {
+            double vy = (double) y / (double) ry;
+            vy *= vy;
+            w = (int) (rx * ::sqrt(std::max(0.0, 1 - vy)));
+            w = std::max(0, std::min(rx, w));
+            while (w < rx && inside(w + 1, vy)) {
+                w++;
+            }
+            while (w > 0 && !inside(w, vy)) {
+                w--;
+            }
+        }
+        img.fill_span(center.y + y, center.x - w, center.x + w, fill);
+    }
+}
+
+// Run f repeatedly for at least 0.2s, return nanoseconds per run.
+template <typename F>
+double time_runs(F f) {
+    typedef std::chrono::steady_clock clock;
+    long runs = 0;
+    auto start = clock::now();
+    double elapsed;
+    do {
+        f();
+        runs++;
+        elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    } while (elapsed < 2e8);
+    return elapsed / runs;
+}
+
+int main() {
+    // Ellipses are drawn into a one pixel wide image, so that spans are
+    // a single pixel and the time is that of finding the row widths.
+    for (int r = 1; r <= 10000; r *= 10) {
+        for (int ry : { r, r / 2 }) {
+            svg::png_image img(1, 2 * ry + 1);
+            double t_new = time_runs([&]() {
+                img.draw_ellipse({ 0, ry }, { r, ry }, { 0, 0, 0 });
+            });
+            double t_old = time_runs([&]() {
+                sqrt_ellipse(img, { 0, ry }, r, ry, { 0, 0, 0 });
+            });
+            int rows = 2 * ry + 1;
+            std::cout << "- radius " << r << " x " << ry << " (" << rows << " rows)\n"
+                      << "  incremental: " << t_new / rows << " ns/row\n"
+                      << "  sqrt search: " << t_old / rows << " ns/row\n";
+        }
+    }
+    return 0;
+}
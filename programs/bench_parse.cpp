@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <tinyxml2.h>
+#include <svg/number_list.hpp>
+
+using namespace tinyxml2;
+
+// Point list parser used before number_list, kept for comparison.
+void stream_parse_points(const std::string &s, std::vector<svg::point> &points) {
+    std::stringstream ss(s);
+    std::string val;
+    while (std::getline(ss, val, ' ')) {
+        val.at(val.find(',')) = ' ';
+        std::stringstream ss2(val);
+        int x, y;
+        ss2 >> x >> y;
+        points.push_back({x, y});
+    }
+}
+
+void collect(XMLElement* elem, std::vector<std::string>& lists) {
+    const char* points = elem->Attribute("points");
+    if (points != NULL) {
+        lists.push_back(points);
+    }
+    for (auto child = elem->FirstChildElement();
+         child != NULL;
+         child = child->NextSiblingElement()) {
+        collect(child, lists);
+    }
+}
+
+// Run f repeatedly for at least 0.2s, return nanoseconds per run.
+template <typename F>
+double time_runs(F f) {
+    typedef std::chrono::steady_clock clock;
+    long runs = 0;
+    auto start = clock::now();
+    double elapsed;
+    do {
+        f();
+        runs++;
+        elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    } while (elapsed < 2e8);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: bench_parse svg_file1 ... svg_filen\n";
+        return 1;
+    }
+    std::vector<std::string> lists;
+    for (int i = 1; i < argc; i++) {
+        XMLDocument doc;
+        if (doc.LoadFile(argv[i]) == XML_SUCCESS) {
+            collect(doc.RootElement(), lists);
+        }
+    }
+    size_t n_points = 0;
+    bool same = true;
+    for (auto& l : lists) {
+        std::vector<svg::point> a, b;
+        stream_parse_points(l, a);
+        b.resize(svg::count_numbers(l.c_str()) / 2);
+        svg::parse_points(l.c_str(), b.data(), b.size());
+        n_points += a.size();
+        for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+            same = same && a[i].x == b[i].x && a[i].y == b[i].y;
+        }
+        same = same && a.size() == b.size();
+    }
+    std::cout << "- " << lists.size() << " point lists, "
+              << n_points << " points" << std::endl;
+    if (!same) {
+        std::cout << "- Parsers disagree!" << std::endl;
+        return 1;
+    }
+
+    std::vector<svg::point> out;
+    double t_stream = time_runs([&]() {
+        for (auto& l : lists) {
+            out.clear();
+            stream_parse_points(l, out);
+        }
+    });
+    double t_list = time_runs([&]() {
+        for (auto& l : lists) {
+            out.resize(svg::count_numbers(l.c_str()) / 2);
+            svg::parse_points(l.c_str(), out.data(), out.size());
+        }
+    });
+    std::cout << "- stringstream parser: " << t_stream / n_points << " ns/point\n"
+              << "- number_list parser:  " << t_list / n_points << " ns/point\n"
+              << "- speedup: " << t_stream / t_list << "x" << std::endl;
+    return 0;
+}
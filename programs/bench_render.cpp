@@ -0,0 +1,44 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <svg/svg.hpp>
+
+// Run f repeatedly for at least 0.2s, return nanoseconds per run.
+template <typename F>
+double time_runs(F f) {
+    typedef std::chrono::steady_clock clock;
+    long runs = 0;
+    auto start = clock::now();
+    double elapsed;
+    do {
+        f();
+        runs++;
+        elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    } while (elapsed < 2e8);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: bench_render svg_file1 ... svg_filen\n";
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        svg::scene sc(argv[i]);
+        svg::png_image rgb(sc.width(), sc.height(), svg::LAYOUT_RGB);
+        svg::png_image rgbx(sc.width(), sc.height(), svg::LAYOUT_RGBX);
+        svg::render_options aa;
+        aa.antialias = true;
+        double t_rgb = time_runs([&]() { sc.render(rgb); });
+        double t_rgbx = time_runs([&]() { sc.render(rgbx); });
+        double t_aa = time_runs([&]() { sc.render(rgb, aa); });
+        std::cout << "- " << argv[i] << " ( " << sc.width() << " x " << sc.height()
+                  << " )\n"
+                  << "  RGB:  " << t_rgb / 1e6 << " ms/render\n"
+                  << "  RGBX: " << t_rgbx / 1e6 << " ms/render\n"
+                  << "  speedup: " << t_rgb / t_rgbx << "x\n"
+                  << "  anti-aliased RGB: " << t_aa / 1e6 << " ms/render ("
+                  << t_aa / t_rgb << "x)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <svg/svg.hpp>
+
+// Points transformed one at a time, as before the batch kernel,
+// kept for comparison.
+void apply_each(const svg::matrix& m, svg::point* points, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        points[i] = m.apply(points[i]);
+    }
+}
+
+// Run f repeatedly for at least 0.2s, return nanoseconds per run.
+template <typename F>
+double time_runs(F f) {
+    typedef std::chrono::steady_clock clock;
+    long runs = 0;
+    auto start = clock::now();
+    double elapsed;
+    do {
+        f();
+        runs++;
+        elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    } while (elapsed < 2e8);
+    return elapsed / runs;
+}
+
+int main() {
+    // The identity would round-trip, so points are moved back and forth
+    // by a rotation and its inverse to keep their values in range.
+    svg::matrix m = svg::matrix::rotation(30).around({ 500, 500 });
+    svg::matrix back = svg::matrix::rotation(-30).around({ 500, 500 });
+    for (size_t n : { 1000, 100000, 1000000, 10000000 }) {
+        std::vector<svg::point> points(n), copy(n);
+        for (size_t i = 0; i < n; i++) {
+            points[i] = { (int) (i % 1000), (int) (i / 1000 % 1000) };
+        }
+        double t_each = time_runs([&]() {
+            apply_each(m, points.data(), n);
+            apply_each(back, points.data(), n);
+        });
+        double t_batch = time_runs([&]() {
+            m.apply(points.data(), n);
+            back.apply(points.data(), n);
+        });
+        double t_copy = time_runs([&]() {
+            ::memcpy(copy.data(), points.data(), n * sizeof(svg::point));
+            ::memcpy(points.data(), copy.data(), n * sizeof(svg::point));
+        });
+        std::cout << "- " << n << " points\n"
+                  << "  one at a time: " << t_each / (2 * n) << " ns/point\n"
+                  << "  batch:         " << t_batch / (2 * n) << " ns/point\n"
+                  << "  memcpy:        " << t_copy / (2 * n) << " ns/point" << std::endl;
+    }
+    return 0;
+}
@@ -1,47 +1,255 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
 #include <svg/svg.hpp>
+#include <svg/parallel.hpp>
 
-void convert(const std::string& svg_file, const std::string& png_file) {
-    std::cout << "- Processing " << svg_file << " ..."  << std::endl;
-    svg::svg_to_png(svg_file, png_file);
-    std::cout << "- Generated " << png_file << std::endl;
+// Convert one file, appending progress messages to log.
+// Returns false if the conversion failed.
+bool convert(const std::string& svg_file, const std::string& png_file,
+             const svg::render_options& options,
+             const svg::png_options& encoding, std::string& log) {
+    log += "- Processing " + svg_file + " ...\n";
+    try {
+        svg::svg_to_png(svg_file, png_file, options, NULL, encoding);
+    } catch (const std::exception& e) {
+        log += std::string("- Failed: ") + e.what() + "\n";
+        return false;
+    }
+    log += "- Generated " + png_file + "\n";
+    return true;
 }
 
-int main(int argc, char** argv) {
-    if (argc < 3) {
-        std::cout << "Usage:" << std::endl
-                  << "  convert svg_file png_file" << std::endl
-                  << "or" << std::endl
-                  << "  convert output_dir svg_file1 ... svg_filen"
-                  << std::endl;
-        return 1;
+// Watch mode: convert svg_file again whenever it changes.
+// The previous scene and image are kept, and only the areas where the
+// new scene differs from the previous one are repainted.
+// Runs until interrupted.
+void watch(const std::string& svg_file, const std::string& png_file,
+           const svg::render_options& options, const svg::png_options& encoding) {
+    std::unique_ptr<svg::scene> shown;
+    std::unique_ptr<svg::png_image> img;
+    struct timespec last_change = { 0, 0 };
+    off_t last_size = -1;
+    std::cout << "- Watching " << svg_file << " ..." << std::endl;
+    for (;; std::this_thread::sleep_for(std::chrono::milliseconds(100))) {
+        struct stat st;
+        if (::stat(svg_file.c_str(), &st) != 0 ||
+            (st.st_mtim.tv_sec == last_change.tv_sec &&
+             st.st_mtim.tv_nsec == last_change.tv_nsec &&
+             st.st_size == last_size)) {
+            continue;
+        }
+        last_change = st.st_mtim;
+        last_size = st.st_size;
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<svg::scene> sc;
+        try {
+            sc.reset(new svg::scene(svg_file, options.streaming));
+        } catch (const std::exception& e) {
+            std::cout << "- Failed: " << e.what() << std::endl;
+            continue;
+        }
+        std::string repainted;
+        if (shown && shown->width() == sc->width() &&
+            shown->height() == sc->height()) {
+            size_t n = sc->render_changes(*img, *shown, options).size();
+            if (n == 0) {
+                shown.swap(sc);
+                continue;
+            }
+            repainted = std::to_string(n) + " areas repainted";
+        } else {
+            img.reset(new svg::png_image(sc->width(), sc->height(), options.layout));
+            sc->render(*img, options);
+            repainted = "full render";
+        }
+        img->save(png_file, encoding);
+        shown.swap(sc);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "- Generated " << png_file << " (" << repainted
+                  << ", " << ms << " ms)" << std::endl;
     }
-    if (argc == 3) {
-        convert(argv[1], argv[2]);
+}
+
+// Output file name for svg_file in output_dir.
+void png_file_name(const std::string& output_dir, const std::string& svg_file,
+                   std::string& png_file) {
+    size_t pos1 = svg_file.rfind('/');
+    if (pos1 == std::string::npos) {
+        pos1 = 0;
     } else {
-        --argc; ++argv;
-        std::string output_dir(argv[0]);
-        while(--argc) {
-            ++argv;
-            std::string svg_file(*argv);
-            std::string png_file;
-            size_t pos1 = svg_file.rfind('/');
-            if (pos1 == std::string::npos) {
-                pos1 = 0;
-            } else {
-                pos1++;
-            }
-            size_t pos2 = svg_file.rfind(".svg");
-            if (pos2 == std::string::npos) {
-                pos2 = svg_file.length();
+        pos1++;
+    }
+    size_t pos2 = svg_file.rfind(".svg");
+    if (pos2 == std::string::npos || pos2 < pos1) {
+        pos2 = svg_file.length();
+    }
+    png_file = output_dir;
+    png_file += '/';
+    png_file.append(svg_file, pos1, pos2 - pos1);
+    png_file += ".png";
+}
+
+// Log messages of each file, written out in input order:
+// a file's messages are printed once all previous files are done.
+class ordered_log {
+private:
+    std::vector<std::string> entries;
+    std::vector<bool> done;
+    size_t next;
+    std::mutex lock;
+public:
+    ordered_log(size_t n) : entries(n), done(n, false), next(0) { }
+    void finish(size_t i, std::string& entry) {
+        std::lock_guard<std::mutex> g(lock);
+        entries[i].swap(entry);
+        done[i] = true;
+        if (next < done.size() && done[next]) {
+            while (next < done.size() && done[next]) {
+                std::cout << entries[next];
+                std::string().swap(entries[next]);
+                next++;
             }
+            std::cout.flush();
+        }
+    }
+};
+
+// Parse a non-negative decimal number.
+// Returns false if s is not one.
+bool parse_count(const char* s, unsigned& value) {
+    char* end;
+    errno = 0;
+    long v = std::strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno != 0 || v < 0 || v > INT_MAX) {
+        return false;
+    }
+    value = (unsigned) v;
+    return true;
+}
+
+void usage() {
+    std::cout << "Usage:\n"
+              << "  convert [options] svg_file png_file\n"
+              << "or\n"
+              << "  convert [options] output_dir svg_file1 ... svg_filen\n"
+              << "Options:\n"
+              << "  -j N      convert N files at a time "
+              << "(0 for one per hardware thread);\n"
+              << "            a single file is encoded with N threads\n"
+              << "  -z N      PNG compression level, from 0 (none) to 9\n"
+              << "  --filter F  PNG row filter: none, sub, up, average,\n"
+              << "              paeth or adaptive (default)\n"
+              << "  --stream  read SVG files with the streaming parser\n"
+              << "  --aa      anti-aliased rendering\n"
+              << "  --rgbx    render with 4 bytes per pixel (faster fills)\n"
+              << "  --watch   convert svg_file again whenever it changes,\n"
+              << "            repainting only the changed areas\n";
+}
+
+// Scratch state owned by each conversion thread.
+struct worker_state {
+    std::string png_file;
+    std::string log;
+};
 
-            png_file = output_dir
-                    + "/"
-                    + svg_file.substr(pos1).substr(0,pos2-pos1)
-                    + ".png";
-            convert(svg_file, png_file);
+int main(int argc, char** argv) {
+    unsigned jobs = 1;
+    bool watching = false;
+    svg::render_options options;
+    svg::png_options encoding;
+    for (;;) {
+        std::string opt(argc > 1 ? argv[1] : "");
+        if (opt == "-j" && argc > 2) {
+            if (!parse_count(argv[2], jobs)) {
+                std::cout << "Invalid number of jobs: " << argv[2] << std::endl;
+                usage();
+                return 1;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (opt == "-z" && argc > 2) {
+            unsigned level;
+            if (!parse_count(argv[2], level) || level > 9) {
+                std::cout << "Invalid compression level: " << argv[2] << std::endl;
+                usage();
+                return 1;
+            }
+            encoding.level = (int) level;
+            argc -= 2;
+            argv += 2;
+        } else if (opt == "--filter" && argc > 2) {
+            if (!svg::parse_png_filter(argv[2], encoding.filter)) {
+                std::cout << "Unknown filter: " << argv[2] << std::endl;
+                return 1;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (opt == "--stream") {
+            options.streaming = true;
+            argc--;
+            argv++;
+        } else if (opt == "--aa") {
+            options.antialias = true;
+            argc--;
+            argv++;
+        } else if (opt == "--rgbx") {
+            options.layout = svg::LAYOUT_RGBX;
+            argc--;
+            argv++;
+        } else if (opt == "--watch") {
+            watching = true;
+            argc--;
+            argv++;
+        } else {
+            break;
         }
     }
+    if (argc < 3 || (watching && argc != 3)) {
+        usage();
+        return 1;
+    }
+    if (watching) {
+        encoding.threads = jobs;
+        watch(argv[1], argv[2], options, encoding);
+        return 0;
+    }
+    if (argc == 3) {
+        std::string log;
+        encoding.threads = jobs;
+        bool ok = convert(argv[1], argv[2], options, encoding, log);
+        std::cout << log;
+        return ok ? 0 : 1;
+    }
+    std::string output_dir(argv[1]);
+    std::vector<std::string> svg_files(argv + 2, argv + argc);
+    size_t n = svg_files.size();
+    std::vector<worker_state> workers(svg::parallel_threads(n, jobs));
+    ordered_log log(n);
+    std::atomic<size_t> failed(0);
+    svg::parallel_for(n, jobs, [&](size_t i, unsigned w) {
+        worker_state& ws = workers[w];
+        png_file_name(output_dir, svg_files[i], ws.png_file);
+        if (!convert(svg_files[i], ws.png_file, options, encoding, ws.log)) {
+            failed++;
+        }
+        log.finish(i, ws.log);
+        ws.log.clear();
+    });
+    if (failed > 0) {
+        std::cout << "- " << failed << " of " << n
+                  << " files could not be converted\n";
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
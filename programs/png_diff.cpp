@@ -1,13 +1,135 @@
-
-
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <svg/svg.hpp>
 
+// Summary of the differences between two images.
+struct diff_stats {
+    size_t pixels;
+    svg::box bounds;
+    int max_delta[3];
+    int first_x, first_y;
+};
+
+// Largest channel difference of two pixels.
+inline int pixel_delta(const svg::color& a, const svg::color& b, int delta[3]) {
+    delta[0] = std::abs(a.red - b.red);
+    delta[1] = std::abs(a.green - b.green);
+    delta[2] = std::abs(a.blue - b.blue);
+    return std::max(delta[0], std::max(delta[1], delta[2]));
+}
+
+// Offset of the first byte in [from, n) where a and b differ by more
+// than tolerance (n if there is none). Bytes are compared 16 at a time.
+size_t next_difference(const unsigned char* a, const unsigned char* b,
+                       size_t from, size_t n, int tolerance) {
+    size_t i = from;
+#ifdef __SSE2__
+    const __m128i tol = _mm_set1_epi8((char) tolerance);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i over = _mm_subs_epu8(d, tol);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(over, zero));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask & 0xFFFF);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (std::abs(a[i] - b[i]) > tolerance) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Compare images of the same size, row by row, and optionally fill
+// a heatmap: pixels that differ are red, darker for larger differences,
+// other pixels are a faded gray version of the first image.
+diff_stats compare(const svg::png_image& img1, const svg::png_image& img2,
+                   int tolerance, svg::png_image* heatmap) {
+    diff_stats st = { 0, { INT_MAX, INT_MAX, INT_MIN, INT_MIN }, { 0, 0, 0 }, -1, -1 };
+    const int w = img1.width();
+    const size_t row_bytes = (size_t) w * sizeof(svg::color);
+    for (int y = 0; y < img1.height(); y++) {
+        // Images loaded from files have the RGB layout.
+        const svg::color* r1 = (const svg::color*) img1.data() + (size_t) y * w;
+        const svg::color* r2 = (const svg::color*) img2.data() + (size_t) y * w;
+        if (heatmap != NULL) {
+            for (int x = 0; x < w; x++) {
+                const svg::color& c = r1[x];
+                int gray = 192 + (c.red * 77 + c.green * 150 + c.blue * 29) / 1024;
+                heatmap->at(x, y) = { (svg::rgb_value) gray, (svg::rgb_value) gray,
+                                      (svg::rgb_value) gray };
+            }
+        }
+        if (::memcmp(r1, r2, row_bytes) == 0) {
+            continue;
+        }
+        const unsigned char* b1 = (const unsigned char*) r1;
+        const unsigned char* b2 = (const unsigned char*) r2;
+        size_t i = next_difference(b1, b2, 0, row_bytes, tolerance);
+        while (i < row_bytes) {
+            int x = (int) (i / sizeof(svg::color));
+            int delta[3];
+            int d = pixel_delta(r1[x], r2[x], delta);
+            for (int c = 0; c < 3; c++) {
+                st.max_delta[c] = std::max(st.max_delta[c], delta[c]);
+            }
+            if (st.pixels == 0) {
+                st.first_x = x;
+                st.first_y = y;
+            }
+            st.pixels++;
+            st.bounds = { std::min(st.bounds.x_min, x), std::min(st.bounds.y_min, y),
+                          std::max(st.bounds.x_max, x), std::max(st.bounds.y_max, y) };
+            if (heatmap != NULL) {
+                svg::rgb_value v = (svg::rgb_value) (200 - d * 200 / 255);
+                heatmap->at(x, y) = { 255, v, v };
+            }
+            i = next_difference(b1, b2, (x + 1) * sizeof(svg::color), row_bytes, tolerance);
+        }
+    }
+    return st;
+}
+
+void print_color(const svg::color& c) {
+    std::cout << '(' << (int) c.red << ',' << (int) c.green << ','
+              << (int) c.blue << ')';
+}
+
 int main(int argc, char** argv) {
+    int tolerance = 0;
+    std::string heatmap_file;
+    for (;;) {
+        std::string opt(argc > 1 ? argv[1] : "");
+        if (opt == "-t" && argc > 2) {
+            tolerance = std::max(0, std::min(255, std::atoi(argv[2])));
+        } else if (opt == "--heatmap" && argc > 2) {
+            heatmap_file = argv[2];
+        } else {
+            break;
+        }
+        argc -= 2;
+        argv += 2;
+    }
     if (argc != 3) {
-        std::cout << "Usage: image_diff file1.png file2.png";
+        std::cout << "Usage: png_diff [options] file1.png file2.png\n"
+                  << "Options:\n"
+                  << "  -t N           ignore channel differences up to N\n"
+                  << "  --heatmap F    save an image of the differences to F\n";
         return 1;
     }
     std::string file1(argv[1]);
@@ -23,32 +145,33 @@ int main(int argc, char** argv) {
               << " ( " << img2.width()
               << " x " << img2.height()
               << " )"  << std::endl;
-    bool eq = img1.width() == img2.width() &&
-              img1.height() == img2.height();
-    if (!eq) {
+    if (img1.width() != img2.width() || img1.height() != img2.height()) {
         std::cout << "- Different image dimensions!" << std::endl;
-    } else {
-        for (int x = 0; x < img1.width() && eq ; x++) {
-            for (int y = 0; y < img1.height() && eq; y++) {
-                const svg::color& c1 = img1.at(x, y);
-                const svg::color& c2 = img2.at(x, y);
-                eq = (c1 == c2);
-                if (!eq) {
-                    std::cout << "- Pixel (" << x << ',' << y << ") is different: "
-                               << '(' << (int) c1.red << ',' <<
-                              (int) c1.green << ','
-                              << (int) c1.blue
-                              << ") != ("
-                              << (int) c2.red << ',' <<
-                              (int) c2.green << ','
-                              << (int) c2.blue
-                              << ')' << std::endl;
-                }
-            }
-        }
+        return 1;
+    }
+    std::unique_ptr<svg::png_image> heatmap;
+    if (!heatmap_file.empty()) {
+        heatmap.reset(new svg::png_image(img1.width(), img1.height()));
     }
-    if (eq) {
+    diff_stats st = compare(img1, img2, tolerance, heatmap.get());
+    if (st.pixels == 0) {
         std::cout << "- No differences found!" << std::endl;
+    } else {
+        const svg::color& c1 = img1.at(st.first_x, st.first_y);
+        const svg::color& c2 = img2.at(st.first_x, st.first_y);
+        std::cout << "- Pixel (" << st.first_x << ',' << st.first_y << ") is different: ";
+        print_color(c1);
+        std::cout << " != ";
+        print_color(c2);
+        std::cout << "\n- " << st.pixels << " different pixels, in ("
+                  << st.bounds.x_min << ',' << st.bounds.y_min << ")-("
+                  << st.bounds.x_max << ',' << st.bounds.y_max << ")\n"
+                  << "- Largest difference: (" << st.max_delta[0] << ','
+                  << st.max_delta[1] << ',' << st.max_delta[2] << ')' << std::endl;
+    }
+    if (heatmap) {
+        heatmap->save(heatmap_file);
+        std::cout << "- Generated " << heatmap_file << std::endl;
     }
-    return eq ? 0 : 1;
+    return st.pixels == 0 ? 0 : 1;
 }
@@ -1,24 +1,144 @@
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <svg/svg.hpp>
 
+// Output written through a large buffer.
+class buffered_writer {
+private:
+    FILE* out;
+    std::vector<char> buffer;
+    size_t used;
+public:
+    buffered_writer(FILE* out) : out(out), buffer(1 << 20), used(0) { }
+    ~buffered_writer() {
+        flush();
+    }
+    void flush() {
+        ::fwrite(buffer.data(), 1, used, out);
+        used = 0;
+    }
+    void write(const char* s, size_t n) {
+        if (used + n > buffer.size()) {
+            flush();
+            if (n > buffer.size()) {
+                ::fwrite(s, 1, n, out);
+                return;
+            }
+        }
+        ::memcpy(buffer.data() + used, s, n);
+        used += n;
+    }
+    void put(char c) {
+        if (used == buffer.size()) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+    void put(const std::string& s) {
+        write(s.data(), s.size());
+    }
+    void put(unsigned v) {
+        char digits[10];
+        int n = 0;
+        do {
+            digits[n++] = (char) ('0' + v % 10);
+            v /= 10;
+        } while (v > 0);
+        while (n > 0) {
+            put(digits[--n]);
+        }
+    }
+};
+
+enum dump_format { TEXT, CSV, RAW, PPM };
+
 int main(int argc, char** argv) {
+    dump_format format = TEXT;
+    svg::box region = { 0, 0, -1, -1 };
+    bool has_region = false;
+    for (;;) {
+        std::string opt(argc > 1 ? argv[1] : "");
+        if (opt == "--format" && argc > 2) {
+            std::string f(argv[2]);
+            if (f == "text") {
+                format = TEXT;
+            } else if (f == "csv") {
+                format = CSV;
+            } else if (f == "raw") {
+                format = RAW;
+            } else if (f == "ppm") {
+                format = PPM;
+            } else {
+                std::cerr << "Unknown format: " << f << std::endl;
+                return 1;
+            }
+        } else if (opt == "--region" && argc > 2) {
+            int x, y, w, h;
+            if (std::sscanf(argv[2], "%d,%d,%d,%d", &x, &y, &w, &h) != 4) {
+                std::cerr << "Invalid region: " << argv[2] << std::endl;
+                return 1;
+            }
+            region = { x, y, x + w - 1, y + h - 1 };
+            has_region = true;
+        } else {
+            break;
+        }
+        argc -= 2;
+        argv += 2;
+    }
     if (argc != 2) {
-        std::cout << "Usage: image_dump file.png";
+        std::cout << "Usage: png_dump [options] file.png\n"
+                  << "Options:\n"
+                  << "  --format F         text (default), csv, raw (RGB bytes) or ppm\n"
+                  << "  --region x,y,w,h   dump only the given rectangle\n";
         return 1;
     }
     svg::png_image img(argv[1]);
-    std::cout << "- Loaded " << argv[1]
-              << " ( " << img.width()
-              << " x " << img.height()
-              << " )"  << std::endl;
-    for (int x = 0; x < img.width(); x++) {
-        for (int y = 0; y < img.height(); y++) {
-            const svg::color& c = img.at(x, y);
-            std::cout << x << ',' << y << " --> "
-                      << (int) c.red << ','
-                      << (int) c.green << ','
-                      << (int) c.blue << std::endl;
+    svg::box all = { 0, 0, img.width() - 1, img.height() - 1 };
+    region = has_region ? region.intersect(all) : all;
+    if (region.empty()) {
+        std::cerr << "- Region outside the image" << std::endl;
+        return 1;
+    }
+    // Messages only go with the text format; the others are for programs.
+    if (format == TEXT) {
+        std::cout << "- Loaded " << argv[1]
+                  << " ( " << img.width()
+                  << " x " << img.height()
+                  << " )"  << std::endl;
+    }
+    int w = region.x_max - region.x_min + 1;
+    int h = region.y_max - region.y_min + 1;
+    buffered_writer out(stdout);
+    if (format == CSV) {
+        out.put(std::string("x,y,red,green,blue\n"));
+    } else if (format == PPM) {
+        out.put("P6\n" + std::to_string(w) + ' ' + std::to_string(h) + "\n255\n");
+    }
+    for (int y = region.y_min; y <= region.y_max; y++) {
+        // Images loaded from files have the RGB layout.
+        const svg::color* row = (const svg::color*) img.data() + (size_t) y * img.width();
+        if (format == RAW || format == PPM) {
+            out.write((const char*) (row + region.x_min), (size_t) w * sizeof(svg::color));
+            continue;
+        }
+        const char* arrow = format == TEXT ? " --> " : ",";
+        size_t arrow_len = ::strlen(arrow);
+        for (int x = region.x_min; x <= region.x_max; x++) {
+            const svg::color& c = row[x];
+            out.put((unsigned) x);
+            out.put(',');
+            out.put((unsigned) y);
+            out.write(arrow, arrow_len);
+            out.put((unsigned) c.red);
+            out.put(',');
+            out.put((unsigned) c.green);
+            out.put(',');
+            out.put((unsigned) c.blue);
+            out.put('\n');
         }
     }
     return 0;
@@ -0,0 +1,68 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace svg {
+    arena::arena(size_t initial_block_size) :
+            next(NULL), end(NULL),
+            block_size(std::max(initial_block_size, (size_t) 256)),
+            cleanups(NULL) {
+
+    }
+
+    arena::~arena() {
+        for (cleanup* c = cleanups; c != NULL; c = c->next) {
+            c->destroy(c->object);
+        }
+        for (auto b : blocks) {
+            ::free(b);
+        }
+    }
+
+    void arena::reset() {
+        for (cleanup* c = cleanups; c != NULL; c = c->next) {
+            c->destroy(c->object);
+        }
+        cleanups = NULL;
+        if (blocks.empty()) {
+            return;
+        }
+        char* last = blocks.back();
+        for (size_t i = 0; i + 1 < blocks.size(); i++) {
+            ::free(blocks[i]);
+        }
+        blocks.assign(1, last);
+        next = last;
+    }
+
+    void arena::grow(size_t size) {
+        // Blocks double in size (up to a limit), so that the number of
+        // blocks grows logarithmically with the total allocated memory.
+        const size_t max_block_size = 16 * 1024 * 1024;
+        size_t sz = std::max(block_size, size);
+        char* b = (char*) ::malloc(sz);
+        if (b == NULL) {
+            throw std::bad_alloc();
+        }
+        blocks.push_back(b);
+        next = b;
+        end = b + sz;
+        block_size = std::min(block_size * 2, max_block_size);
+    }
+
+    void* arena::allocate(size_t size, size_t align) {
+        uintptr_t p = ((uintptr_t) next + align - 1) & ~(uintptr_t) (align - 1);
+        if (next == NULL || p + size > (uintptr_t) end) {
+            grow(size + align);
+            p = ((uintptr_t) next + align - 1) & ~(uintptr_t) (align - 1);
+        }
+        next = (char*) (p + size);
+        return (void*) p;
+    }
+
+    size_t arena::block_count() const {
+        return blocks.size();
+    }
+}
@@ -0,0 +1,85 @@
+//! @file arena.hpp
+#ifndef __svg_arena_hpp__
+#define __svg_arena_hpp__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace svg {
+    //! Monotonic memory arena.
+    //! Memory is handed out from large blocks and only released,
+    //! all at once, when the arena is destroyed. Objects created with
+    //! make() are destroyed at that point, in reverse order of creation.
+    class arena {
+    private:
+        //! Node of the list of objects to destroy.
+        struct cleanup {
+            void (*destroy)(void*);
+            void* object;
+            cleanup* next;
+        };
+        //! Memory blocks.
+        std::vector<char*> blocks;
+        //! Next free byte in the current block.
+        char* next;
+        //! End of the current block.
+        char* end;
+        //! Size of the next block to allocate.
+        size_t block_size;
+        //! Objects to destroy, most recent first.
+        cleanup* cleanups;
+        //! Allocate a new block with room for at least size bytes.
+        void grow(size_t size);
+    public:
+        //! Constructor.
+        //! @param initial_block_size Size of the first block, in bytes.
+        arena(size_t initial_block_size = 64 * 1024);
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+        //! Destructor.
+        //! Destroys all objects created with make() and frees all memory.
+        ~arena();
+        //! Allocate raw memory.
+        //! @param size Number of bytes.
+        //! @param align Alignment.
+        //! @return Pointer to memory.
+        void* allocate(size_t size, size_t align);
+        //! Create an object in the arena.
+        //! @param args Constructor arguments.
+        //! @return Pointer to the object.
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            void* p = allocate(sizeof(T), alignof(T));
+            T* obj = new (p) T(std::forward<Args>(args)...);
+            if (!std::is_trivially_destructible<T>::value) {
+                cleanup* c = (cleanup*) allocate(sizeof(cleanup), alignof(cleanup));
+                c->destroy = [](void* o) { static_cast<T*>(o)->~T(); };
+                c->object = obj;
+                c->next = cleanups;
+                cleanups = c;
+            }
+            return obj;
+        }
+        //! Allocate an array of trivially copyable values.
+        //! Arrays allocated one after the other are contiguous in memory,
+        //! except when a new block is started.
+        //! @param n Number of elements.
+        //! @return Pointer to first (uninitialized) element.
+        template <typename T>
+        T* make_array(size_t n) {
+            static_assert(std::is_trivially_destructible<T>::value,
+                          "arena arrays are never destroyed");
+            return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+        }
+        //! Destroy all objects and make all memory available again.
+        //! The current block is kept for reuse, other blocks are freed.
+        void reset();
+        //! Get number of memory blocks allocated so far.
+        //! @return Number of blocks.
+        size_t block_count() const;
+    };
+}
+#endif
@@ -0,0 +1,48 @@
+//! @file box.hpp
+#ifndef __svg_box_hpp__
+#define __svg_box_hpp__
+
+#include <algorithm>
+
+namespace svg {
+    //! Axis-aligned rectangle of pixels (bounds are inclusive).
+    struct box {
+        //! Minimum X coordinate.
+        int x_min;
+        //! Minimum Y coordinate.
+        int y_min;
+        //! Maximum X coordinate.
+        int x_max;
+        //! Maximum Y coordinate.
+        int y_max;
+        //! Check if box has no pixels.
+        //! @return true if box is empty.
+        bool empty() const {
+            return x_min > x_max || y_min > y_max;
+        }
+        //! Intersection.
+        //! @param b Other box.
+        //! @return Pixels common to both boxes.
+        box intersect(const box& b) const {
+            return { std::max(x_min, b.x_min), std::max(y_min, b.y_min),
+                     std::min(x_max, b.x_max), std::min(y_max, b.y_max) };
+        }
+        //! Grow (or shrink) the box. Empty boxes stay empty.
+        //! @param d Pixels added on each side (removed if negative).
+        //! @return Grown box.
+        box grow(int d) const {
+            if (empty()) {
+                return *this;
+            }
+            return { x_min - d, y_min - d, x_max + d, y_max + d };
+        }
+        //! Containment.
+        //! @param b Other box.
+        //! @return true if all pixels of b are in this box.
+        bool contains(const box& b) const {
+            return b.x_min >= x_min && b.x_max <= x_max &&
+                   b.y_min >= y_min && b.y_max <= y_max;
+        }
+    };
+}
+#endif
@@ -18,5 +18,9 @@ namespace svg {
     inline bool operator!=(const color& a, const color& b) {
         return ! (a == b);
     }
+    //! Combine two opacities, from 0 (transparent) to 255 (opaque).
+    inline rgb_value multiply_alpha(rgb_value a, rgb_value b) {
+        return (rgb_value) ((a * b + 127) / 255);
+    }
 }
 #endif
\ No newline at end of file
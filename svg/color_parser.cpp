@@ -0,0 +1,439 @@
+#include "color_parser.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <strings.h>
+#include "number_list.hpp"
+
+namespace svg {
+    namespace {
+        struct named_color {
+            const char* name;
+            color c;
+        };
+
+        // Hash of a lower-cased name, for a given displacement value.
+        uint32_t name_hash(const char* name, size_t len, uint32_t d) {
+            uint32_t h = 2166136261U ^ d;
+            for (size_t i = 0; i < len; i++) {
+                unsigned char ch = (unsigned char) name[i];
+                if (ch >= 'A' && ch <= 'Z') {
+                    ch += 'a' - 'A';
+                }
+                h ^= ch;
+                h *= 16777619U;
+            }
+            h ^= h >> 15;
+            h *= 0x2c1b3c6dU;
+            h ^= h >> 12;
+            return h;
+        }
+
+        // Perfect hash table of the 147 SVG named colors (hash and
+        // displace): a name hashed with displacement 0 selects one of the
+        // 64 buckets, and hashing it again with the bucket displacement
+        // gives its slot, which no other color name uses. The
+        // displacements were found offline with the name_hash function.
+        // "green" keeps the value (0, 255, 0) this project has always used
+        // (and its expected images rely on), not the CSS (0, 128, 0).
+        const size_t MAX_NAME_LENGTH = 20;
+        const uint8_t DISPLACEMENT[64] = {
+                    1,     3,     2,     2,     1,     3,     1,     3,
+                    1,     0,     8,     1,     2,     0,     0,     1,
+                    0,     2,     8,     4,     1,     1,     1,     1,
+                    6,     1,     3,     2,     4,     1,     1,     1,
+                    4,     1,     2,     1,     1,     4,     5,     1,
+                    2,     1,     1,     1,     1,     1,     3,     1,
+                    1,     2,     2,     5,     0,    14,     1,     1,
+                    1,     5,     1,     3,     2,     0,     2,     2
+        };
+        const named_color SLOTS[256] = {
+                {"",                     {  0,   0,   0}},
+                {"navajowhite",           {255, 222, 173}},
+                {"khaki",                 {240, 230, 140}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"deeppink",              {255,  20, 147}},
+                {"maroon",                {128,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"darkmagenta",           {139,   0, 139}},
+                {"tomato",                {255,  99,  71}},
+                {"",                     {  0,   0,   0}},
+                {"lightgrey",             {211, 211, 211}},
+                {"darksalmon",            {233, 150, 122}},
+                {"",                     {  0,   0,   0}},
+                {"magenta",               {255,   0, 255}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"whitesmoke",            {245, 245, 245}},
+                {"palegreen",             {152, 251, 152}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"hotpink",               {255, 105, 180}},
+                {"",                     {  0,   0,   0}},
+                {"darkgrey",              {169, 169, 169}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"lightsteelblue",        {176, 196, 222}},
+                {"",                     {  0,   0,   0}},
+                {"darkgreen",             {  0, 100,   0}},
+                {"lime",                  {  0, 255,   0}},
+                {"chocolate",             {210, 105,  30}},
+                {"lightskyblue",          {135, 206, 250}},
+                {"purple",                {128,   0, 128}},
+                {"gold",                  {255, 215,   0}},
+                {"tan",                   {210, 180, 140}},
+                {"lightcyan",             {224, 255, 255}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"lightslategrey",        {119, 136, 153}},
+                {"mediumslateblue",       {123, 104, 238}},
+                {"lightyellow",           {255, 255, 224}},
+                {"",                     {  0,   0,   0}},
+                {"lightseagreen",         { 32, 178, 170}},
+                {"indianred",             {205,  92,  92}},
+                {"antiquewhite",          {250, 235, 215}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"gray",                  {128, 128, 128}},
+                {"green",                 {  0, 255,   0}},
+                {"darkorange",            {255, 140,   0}},
+                {"",                     {  0,   0,   0}},
+                {"mistyrose",             {255, 228, 225}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"darkgray",              {169, 169, 169}},
+                {"",                     {  0,   0,   0}},
+                {"orangered",             {255,  69,   0}},
+                {"",                     {  0,   0,   0}},
+                {"thistle",               {216, 191, 216}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"chartreuse",            {127, 255,   0}},
+                {"floralwhite",           {255, 250, 240}},
+                {"",                     {  0,   0,   0}},
+                {"aqua",                  {  0, 255, 255}},
+                {"white",                 {255, 255, 255}},
+                {"lightsalmon",           {255, 160, 122}},
+                {"bisque",                {255, 228, 196}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"burlywood",             {222, 184, 135}},
+                {"",                     {  0,   0,   0}},
+                {"orange",                {255, 165,   0}},
+                {"darkkhaki",             {189, 183, 107}},
+                {"slateblue",             {106,  90, 205}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"peachpuff",             {255, 218, 185}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"papayawhip",            {255, 239, 213}},
+                {"",                     {  0,   0,   0}},
+                {"springgreen",           {  0, 255, 127}},
+                {"linen",                 {250, 240, 230}},
+                {"lavenderblush",         {255, 240, 245}},
+                {"mediumaquamarine",      {102, 205, 170}},
+                {"pink",                  {255, 192, 203}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"wheat",                 {245, 222, 179}},
+                {"",                     {  0,   0,   0}},
+                {"blueviolet",            {138,  43, 226}},
+                {"sandybrown",            {244, 164,  96}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"cornsilk",              {255, 248, 220}},
+                {"darkslategrey",         { 47,  79,  79}},
+                {"",                     {  0,   0,   0}},
+                {"plum",                  {221, 160, 221}},
+                {"salmon",                {250, 128, 114}},
+                {"skyblue",               {135, 206, 235}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"seashell",              {255, 245, 238}},
+                {"gainsboro",             {220, 220, 220}},
+                {"lightgreen",            {144, 238, 144}},
+                {"rosybrown",             {188, 143, 143}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"steelblue",             { 70, 130, 180}},
+                {"snow",                  {255, 250, 250}},
+                {"orchid",                {218, 112, 214}},
+                {"oldlace",               {253, 245, 230}},
+                {"lemonchiffon",          {255, 250, 205}},
+                {"deepskyblue",           {  0, 191, 255}},
+                {"slategray",             {112, 128, 144}},
+                {"greenyellow",           {173, 255,  47}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"aquamarine",            {127, 255, 212}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"indigo",                { 75,   0, 130}},
+                {"mediumturquoise",       { 72, 209, 204}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"lawngreen",             {124, 252,   0}},
+                {"",                     {  0,   0,   0}},
+                {"palegoldenrod",         {238, 232, 170}},
+                {"lightgray",             {211, 211, 211}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"navy",                  {  0,   0, 128}},
+                {"palevioletred",         {219, 112, 147}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"red",                   {255,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"lightslategray",        {119, 136, 153}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"ghostwhite",            {248, 248, 255}},
+                {"dimgrey",               {105, 105, 105}},
+                {"",                     {  0,   0,   0}},
+                {"turquoise",             { 64, 224, 208}},
+                {"",                     {  0,   0,   0}},
+                {"paleturquoise",         {175, 238, 238}},
+                {"seagreen",              { 46, 139,  87}},
+                {"",                     {  0,   0,   0}},
+                {"aliceblue",             {240, 248, 255}},
+                {"azure",                 {240, 255, 255}},
+                {"blue",                  {  0,   0, 255}},
+                {"",                     {  0,   0,   0}},
+                {"forestgreen",           { 34, 139,  34}},
+                {"cyan",                  {  0, 255, 255}},
+                {"",                     {  0,   0,   0}},
+                {"mintcream",             {245, 255, 250}},
+                {"dodgerblue",            { 30, 144, 255}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"fuchsia",               {255,   0, 255}},
+                {"lightcoral",            {240, 128, 128}},
+                {"yellow",                {255, 255,   0}},
+                {"",                     {  0,   0,   0}},
+                {"goldenrod",             {218, 165,  32}},
+                {"violet",                {238, 130, 238}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"firebrick",             {178,  34,  34}},
+                {"brown",                 {165,  42,  42}},
+                {"blanchedalmond",        {255, 235, 205}},
+                {"black",                 {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"ivory",                 {255, 255, 240}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"moccasin",              {255, 228, 181}},
+                {"olivedrab",             {107, 142,  35}},
+                {"",                     {  0,   0,   0}},
+                {"saddlebrown",           {139,  69,  19}},
+                {"mediumspringgreen",     {  0, 250, 154}},
+                {"lavender",              {230, 230, 250}},
+                {"peru",                  {205, 133,  63}},
+                {"midnightblue",          { 25,  25, 112}},
+                {"",                     {  0,   0,   0}},
+                {"beige",                 {245, 245, 220}},
+                {"",                     {  0,   0,   0}},
+                {"crimson",               {220,  20,  60}},
+                {"darkred",               {139,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"mediumpurple",          {147, 112, 219}},
+                {"darkslategray",         { 47,  79,  79}},
+                {"slategrey",             {112, 128, 144}},
+                {"darkgoldenrod",         {184, 134,  11}},
+                {"mediumseagreen",        { 60, 179, 113}},
+                {"darkolivegreen",        { 85, 107,  47}},
+                {"teal",                  {  0, 128, 128}},
+                {"powderblue",            {176, 224, 230}},
+                {"darkorchid",            {153,  50, 204}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"darkslateblue",         { 72,  61, 139}},
+                {"",                     {  0,   0,   0}},
+                {"lightgoldenrodyellow",  {250, 250, 210}},
+                {"mediumblue",            {  0,   0, 205}},
+                {"silver",                {192, 192, 192}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"lightblue",             {173, 216, 230}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"limegreen",             { 50, 205,  50}},
+                {"olive",                 {128, 128,   0}},
+                {"darkseagreen",          {143, 188, 143}},
+                {"darkviolet",            {148,   0, 211}},
+                {"",                     {  0,   0,   0}},
+                {"sienna",                {160,  82,  45}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"cornflowerblue",        {100, 149, 237}},
+                {"mediumvioletred",       {199,  21, 133}},
+                {"darkcyan",              {  0, 139, 139}},
+                {"cadetblue",             { 95, 158, 160}},
+                {"mediumorchid",          {186,  85, 211}},
+                {"grey",                  {128, 128, 128}},
+                {"",                     {  0,   0,   0}},
+                {"darkturquoise",         {  0, 206, 209}},
+                {"",                     {  0,   0,   0}},
+                {"dimgray",               {105, 105, 105}},
+                {"",                     {  0,   0,   0}},
+                {"lightpink",             {255, 182, 193}},
+                {"",                     {  0,   0,   0}},
+                {"",                     {  0,   0,   0}},
+                {"coral",                 {255, 127,  80}},
+                {"honeydew",              {240, 255, 240}},
+                {"yellowgreen",           {154, 205,  50}},
+                {"darkblue",              {  0,   0, 139}},
+                {"royalblue",             { 65, 105, 225}},
+        };
+
+        // Value of a hexadecimal digit, or -1.
+        const int8_t HEX_DIGIT[256] = {
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+                -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+        };
+
+        // Decode #RGB, #RGBA, #RRGGBB or #RRGGBBAA digits. All digits are
+        // looked up and validated together, without branching on each one.
+        bool parse_hex(const char* s, size_t len, color& c, rgb_value& alpha) {
+            const unsigned char* u = (const unsigned char*) s;
+            if (len == 6 || len == 8) {
+                int d0 = HEX_DIGIT[u[0]], d1 = HEX_DIGIT[u[1]], d2 = HEX_DIGIT[u[2]];
+                int d3 = HEX_DIGIT[u[3]], d4 = HEX_DIGIT[u[4]], d5 = HEX_DIGIT[u[5]];
+                int d6 = len == 8 ? HEX_DIGIT[u[6]] : 0xF;
+                int d7 = len == 8 ? HEX_DIGIT[u[7]] : 0xF;
+                if ((d0 | d1 | d2 | d3 | d4 | d5 | d6 | d7) < 0) {
+                    return false;
+                }
+                c = { (rgb_value) (d0 << 4 | d1),
+                      (rgb_value) (d2 << 4 | d3),
+                      (rgb_value) (d4 << 4 | d5) };
+                alpha = (rgb_value) (d6 << 4 | d7);
+                return true;
+            }
+            if (len == 3 || len == 4) {
+                int d0 = HEX_DIGIT[u[0]], d1 = HEX_DIGIT[u[1]], d2 = HEX_DIGIT[u[2]];
+                int d3 = len == 4 ? HEX_DIGIT[u[3]] : 0xF;
+                if ((d0 | d1 | d2 | d3) < 0) {
+                    return false;
+                }
+                c = { (rgb_value) (d0 * 0x11),
+                      (rgb_value) (d1 * 0x11),
+                      (rgb_value) (d2 * 0x11) };
+                alpha = (rgb_value) (d3 * 0x11);
+                return true;
+            }
+            return false;
+        }
+
+        bool is_space(char ch) {
+            return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+        }
+    }
+
+    bool find_named_color(const char* name, size_t len, color& c) {
+        if (len == 0 || len > MAX_NAME_LENGTH) {
+            return false;
+        }
+        uint32_t d = DISPLACEMENT[name_hash(name, len, 0) % 64];
+        const named_color& nc = SLOTS[name_hash(name, len, d) % 256];
+        if (::strlen(nc.name) != len) {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            char ch = name[i];
+            if (ch >= 'A' && ch <= 'Z') {
+                ch += 'a' - 'A';
+            }
+            if (ch != nc.name[i]) {
+                return false;
+            }
+        }
+        c = nc.c;
+        return true;
+    }
+
+    color parse_color(const char* str) {
+        rgb_value alpha;
+        return parse_color(str, alpha);
+    }
+
+    color parse_color(const char* str, rgb_value& alpha) {
+        const char* s = str;
+        while (is_space(*s)) {
+            s++;
+        }
+        size_t len = ::strlen(s);
+        while (len > 0 && is_space(s[len - 1])) {
+            len--;
+        }
+        color c;
+        alpha = 255;
+        bool ok;
+        if (len > 0 && s[0] == '#') {
+            ok = parse_hex(s + 1, len - 1, c, alpha);
+        } else if (len == 11 && ::strncasecmp(s, "transparent", len) == 0) {
+            c = { 0, 0, 0 };
+            alpha = 0;
+            ok = true;
+        } else {
+            ok = find_named_color(s, len, c);
+        }
+        if (!ok) {
+            throw std::runtime_error(std::string(str) + ": unrecognised color!");
+        }
+        return c;
+    }
+
+    rgb_value parse_opacity(const char* str) {
+        if (str == NULL) {
+            return 255;
+        }
+        const char* p = str;
+        double v;
+        if (!parse_number(p, v)) {
+            throw std::runtime_error(std::string(str) + ": invalid opacity!");
+        }
+        if (*p == '%') {
+            v /= 100;
+        }
+        v = v < 0 ? 0 : v > 1 ? 1 : v;
+        return (rgb_value) ::lround(v * 255);
+    }
+}
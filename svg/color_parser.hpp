@@ -0,0 +1,35 @@
+//! @file color_parser.hpp
+#ifndef __svg_color_parser_hpp__
+#define __svg_color_parser_hpp__
+
+#include <cstddef>
+#include "color.hpp"
+
+namespace svg {
+    //! Look up an SVG/CSS named color (case-insensitive).
+    //! @param name Color name.
+    //! @param len Length of name.
+    //! @param c Set to the color, if found.
+    //! @return true if the name is a known color.
+    bool find_named_color(const char* name, size_t len, color& c);
+    //! Parse an SVG color: a color name, #RGB or #RRGGBB.
+    //! Parsing does not allocate memory (except for the error message).
+    //! Throws std::runtime_error for unrecognised colors.
+    //! @param str Color text.
+    //! @return Parsed color.
+    color parse_color(const char* str);
+    //! Parse an SVG color with its opacity: as above, plus "transparent",
+    //! #RGBA and #RRGGBBAA.
+    //! Throws std::runtime_error for unrecognised colors.
+    //! @param str Color text.
+    //! @param alpha Set to the opacity of the color (255 if opaque).
+    //! @return Parsed color.
+    color parse_color(const char* str, rgb_value& alpha);
+    //! Parse an opacity attribute: a number from 0 to 1, or a percentage.
+    //! Values out of range are clamped.
+    //! Throws std::runtime_error if there is no number.
+    //! @param str Opacity text (NULL for a missing attribute).
+    //! @return Opacity, from 0 (transparent) to 255 (opaque).
+    rgb_value parse_opacity(const char* str);
+}
+#endif
@@ -1,6 +1,20 @@
 #include "elements.hpp"
+#include <algorithm>
+#include <climits>
 
 namespace svg {
+    box points_bounds(const point *points, size_t n) {
+        box b = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (size_t i = 0; i < n; i++) {
+            const point &p = points[i];
+            b.x_min = std::min(b.x_min, p.x);
+            b.y_min = std::min(b.y_min, p.y);
+            b.x_max = std::max(b.x_max, p.x);
+            b.y_max = std::max(b.y_max, p.y);
+        }
+        return b;
+    }
+
     ellipse::ellipse(const svg::color &fill,
                      const point &center,
                      const point &radius) :
@@ -8,22 +22,53 @@ namespace svg {
 
     }
     void ellipse::draw(png_image &img) const {
-        img.draw_ellipse(center, radius, get_color());
+        img.draw_ellipse(center, radius, get_color(), get_opacity());
     }
-    void ellipse::translate(const point &t) {
-        center = center.translate(t);
+    void ellipse::record(scene &s) const {
+        s.add_ellipse(get_color(), center, radius, bounds(), interior(),
+                      get_opacity());
     }
-    void ellipse::scale(const point &origin, int v) {
-        radius.x *= v;
-        radius.y *= v;
-        center = center.scale(origin,v);
+    box ellipse::bounds() const {
+        return { center.x - radius.x, center.y - radius.y,
+                 center.x + radius.x, center.y + radius.y };
     }
-
-    void ellipse::rotate(const point &origin, int degrees) {
-        center = center.rotate(origin, degrees);
+    box ellipse::transformed_bounds(const matrix &m) const {
+        // Ellipses stay axis-aligned (see transform()): the corners of
+        // the box would not bound a rotated ellipse.
+        point c = m.apply(center);
+        int rx = (int) ::lround(radius.x * m.x_scale());
+        int ry = (int) ::lround(radius.y * m.y_scale());
+        return { c.x - rx, c.y - ry, c.x + rx, c.y + ry };
     }
-    shape *ellipse::duplicate() const {
-        return new ellipse(get_color(), center, radius);
+    box ellipse::interior() const {
+        // Rows up to hy away from the center are at least 2 * hx + 1
+        // pixels wide, where hx satisfies the same test used by
+        // png_image::draw_ellipse to find the extent of row hy.
+        int hy = (int) (radius.y / M_SQRT2);
+        double vy = radius.y > 0 ? (double) hy / (double) radius.y : 0;
+        vy *= vy;
+        int hx = std::min(radius.x, (int) (radius.x * ::sqrt(1 - vy)));
+        for (; hx > 0; hx--) {
+            double vx = (double) hx / (double) radius.x;
+            vx *= vx;
+            if (vx + vy <= 1) {
+                break;
+            }
+        }
+        return { center.x - hx, center.y - hy,
+                 center.x + hx, center.y + hy };
+    }
+    void ellipse::transform(const matrix &m) {
+        // The ellipse stays axis-aligned: only its center moves,
+        // and each radius is scaled by the length of the transformed axis.
+        center = m.apply(center);
+        radius.x = (int) ::lround(radius.x * m.x_scale());
+        radius.y = (int) ::lround(radius.y * m.y_scale());
+    }
+    shape *ellipse::duplicate(arena &mem) const {
+        ellipse *e = mem.make<ellipse>(get_color(), center, radius);
+        e->set_opacity(get_opacity());
+        return e;
     }
 
     circle::circle(const color &fill,
@@ -34,78 +79,219 @@ namespace svg {
     }
 
     polygon::polygon(const color &fill,
-                     const std::vector<point> points) :
-                     shape(fill), points(points) {
+                     point *points,
+                     size_t n_points) :
+                     shape(fill), points(points), n_points(n_points) {
 
     }
 
     void polygon::draw(png_image &img) const {
-        img.draw_polygon(points,get_color());
+        img.draw_polygon(points, n_points, get_color(), get_opacity());
     }
 
-    void polygon::translate(const point &t) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].translate(t);
+    void polygon::record(scene &s) const {
+        s.add_polygon(get_color(), points, n_points, bounds(), interior(),
+                      get_opacity());
     }
 
-    void polygon::scale(const point &origin, int v) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].scale(origin,v);
+    box polygon::bounds() const {
+        return points_bounds(points, n_points);
     }
 
-    void polygon::rotate(const point &origin, int v) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].rotate(origin,v);
+    box polygon::interior() const {
+        // Only axis-aligned rectangles are known to fill their bounding box.
+        if (n_points == 4) {
+            const point *p = points;
+            if ((p[0].y == p[1].y && p[1].x == p[2].x &&
+                 p[2].y == p[3].y && p[3].x == p[0].x) ||
+                (p[0].x == p[1].x && p[1].y == p[2].y &&
+                 p[2].x == p[3].x && p[3].y == p[0].y)) {
+                return bounds();
+            }
+        }
+        return { 0, 0, -1, -1 };
     }
 
-    shape *polygon::duplicate() const {
-        return new polygon(get_color(), points);
+    void polygon::transform(const matrix &m) {
+        m.apply(points, n_points);
+    }
+
+    shape *polygon::duplicate(arena &mem) const {
+        point *copy = mem.make_array<point>(n_points);
+        std::copy(points, points + n_points, copy);
+        polygon *p = mem.make<polygon>(get_color(), copy, n_points);
+        p->set_opacity(get_opacity());
+        return p;
     }
 
     rect::rect(const color &fill,
-               std::vector<point> points) :
-               polygon(fill, points) {
+               point *points) :
+               polygon(fill, points, 4) {
 
     }
 
     polyline::polyline(const color &fill,
-                       std::vector<point> points,
+                       point *points,
+                       size_t n_points,
                        const color &stroke) :
                        shape(fill),
                        points(points),
+                       n_points(n_points),
                        stroke(stroke) {
 
 
     }
 
     void polyline::draw(png_image &img) const {
-        for(auto i = 0; i<points.size()-1;i++)
-            img.draw_line(points[i],points[i+1],stroke);
+        img.draw_polyline(points, n_points, stroke, get_opacity());
     }
 
-    void polyline::translate(const point &t) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].translate(t);
+    void polyline::record(scene &s) const {
+        s.add_polyline(stroke, points, n_points, bounds(), get_opacity());
     }
 
-    void polyline::scale(const point &origin, int v) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].scale(origin,v);
+    box polyline::bounds() const {
+        return points_bounds(points, n_points);
     }
 
-    void polyline::rotate(const point &origin, int v) {
-        for(int i =0; i<points.size();i++)
-            points[i] = points[i].rotate(origin,v);
+    void polyline::transform(const matrix &m) {
+        m.apply(points, n_points);
     }
 
-    shape *polyline::duplicate() const {
-        return new polyline(get_color(), points, stroke);
+    shape *polyline::duplicate(arena &mem) const {
+        point *copy = mem.make_array<point>(n_points);
+        std::copy(points, points + n_points, copy);
+        polyline *p = mem.make<polyline>(get_color(), copy, n_points, stroke);
+        p->set_opacity(get_opacity());
+        return p;
     }
 
-    line::line(std::vector<point> points,
+    line::line(point *points,
                const color &stroke) :
-               polyline(get_color(),
-                        points,stroke) {
+               polyline(stroke,
+                        points, 2, stroke) {
+
+    }
+
+    group::group(const std::vector<shape *> &shapes) :
+            shape(color{0, 0, 0}), shapes(shapes),
+            group_transform(matrix::identity()) {
+
+    }
+
+    void group::draw(png_image &img) const {
+        scene s(img.width(), img.height());
+        record(s);
+        s.render(img);
+    }
+
+    void group::record(scene &s) const {
+        arena scratch;
+        record_transformed(s, matrix::identity(), 255, scratch);
+    }
+
+    void group::record_transformed(scene &s, const matrix &m,
+                                   rgb_value opacity, arena &scratch) const {
+        matrix t = m * group_transform;
+        rgb_value o = multiply_alpha(opacity, get_opacity());
+        for (const shape *child : shapes)
+            child->record_transformed(s, t, o, scratch);
+    }
+
+    box group::bounds() const {
+        return transformed_bounds(matrix::identity());
+    }
+
+    box group::transformed_bounds(const matrix &m) const {
+        // Union of the transformed bounding boxes of the shapes.
+        matrix t = m * group_transform;
+        box b = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (const shape *child : shapes) {
+            box tb = child->transformed_bounds(t);
+            if (tb.empty())
+                continue;
+            b = { std::min(b.x_min, tb.x_min), std::min(b.y_min, tb.y_min),
+                  std::max(b.x_max, tb.x_max), std::max(b.y_max, tb.y_max) };
+        }
+        return b;
+    }
+
+    void group::transform(const matrix &m) {
+        group_transform = m * group_transform;
+    }
+
+    shape *group::duplicate(arena &mem) const {
+        std::vector<shape *> copies;
+        copies.reserve(shapes.size());
+        for (const shape *child : shapes)
+            copies.push_back(child->duplicate(mem));
+        group *g = mem.make<group>(copies);
+        g->group_transform = group_transform;
+        g->set_opacity(get_opacity());
+        return g;
+    }
+
+    use::use(const shape *target) :
+            shape(target->get_color()), target(target),
+            use_transform(matrix::identity()) {
+
+    }
+
+    void use::draw(png_image &img) const {
+        scene s(img.width(), img.height());
+        record(s);
+        s.render(img);
+    }
+
+    void use::record(scene &s) const {
+        arena scratch;
+        record_transformed(s, matrix::identity(), 255, scratch);
+    }
+
+    void use::record_transformed(scene &s, const matrix &m,
+                                 rgb_value opacity, arena &scratch) const {
+        matrix t = m * use_transform;
+        rgb_value o = multiply_alpha(opacity, get_opacity());
+        // An opaque instance that only moves its target by whole pixels is a copy
+        // of the same pixels: it is recorded as a sprite instance, so that
+        // the target can be rasterized once for all such instances.
+        bool pixel_translation = o == 255 &&
+                                 t.a == 1 && t.b == 0 && t.c == 0 && t.d == 1 &&
+                                 t.e == ::floor(t.e) && t.f == ::floor(t.f) &&
+                                 ::fabs(t.e) < INT_MAX && ::fabs(t.f) < INT_MAX;
+        uint32_t sprite;
+        if (pixel_translation && !s.find_sprite(target, sprite)) {
+            if (s.begin_sprite(target, sprite)) {
+                target->record_transformed(s, matrix::identity(), 255, scratch);
+                s.end_sprite();
+            } else {
+                pixel_translation = false;
+            }
+        }
+        if (pixel_translation) {
+            s.add_sprite(sprite, { (int) t.e, (int) t.f });
+        } else {
+            target->record_transformed(s, t, o, scratch);
+        }
+    }
+
+    box use::bounds() const {
+        return target->transformed_bounds(use_transform);
+    }
+
+    box use::transformed_bounds(const matrix &m) const {
+        return target->transformed_bounds(m * use_transform);
+    }
+
+    void use::transform(const matrix &m) {
+        use_transform = m * use_transform;
+    }
 
+    shape *use::duplicate(arena &mem) const {
+        // The copy shares the referenced shape.
+        use *u = mem.make<use>(target);
+        u->use_transform = use_transform;
+        u->set_opacity(get_opacity());
+        return u;
     }
 }
@@ -2,7 +2,9 @@
 #ifndef __svg_elements_hpp__
 #define __svg_elements_hpp__
 
+#include "arena.hpp"
 #include "shape.hpp"
+#include "scene.hpp"
 
 namespace svg {
     class ellipse : public shape {
@@ -12,10 +14,12 @@ namespace svg {
     public:
         ellipse(const svg::color &fill, const point &center, const point &radius);
         void draw(png_image &img) const override;
-        void translate(const point &t) override;
-        void scale(const point &origin, int v) override;
-        void rotate(const point &origin, int v) override;
-        shape *duplicate() const override;
+        void record(scene &s) const override;
+        box bounds() const override;
+        box transformed_bounds(const matrix &m) const override;
+        box interior() const override;
+        void transform(const matrix &m) override;
+        shape *duplicate(arena &mem) const override;
     };
 
     class circle : public ellipse{
@@ -27,28 +31,32 @@ namespace svg {
 
     class polygon : public shape{
     protected:
-        std::vector<point> points;
+        point *points;
+        size_t n_points;
     public:
-        polygon(const svg::color &fill, std::vector<point> points);
+        polygon(const svg::color &fill, point *points, size_t n_points);
         void draw(png_image &img) const override;
-        void translate(const point &t) override;
-        void scale(const point &origin, int v) override;
-        void rotate(const point &origin, int v) override;
-        shape *duplicate() const override;
+        void record(scene &s) const override;
+        box bounds() const override;
+        box interior() const override;
+        void transform(const matrix &m) override;
+        shape *duplicate(arena &mem) const override;
 
     };
 
     class polyline : public shape{
     protected:
-        std::vector<point> points;
+        point *points;
+        size_t n_points;
         color stroke;
     public:
-        polyline(const svg::color &fill, std::vector<point> points, const svg::color &stroke);
+        polyline(const svg::color &fill, point *points, size_t n_points,
+                 const svg::color &stroke);
         void draw(png_image &img) const override;
-        void translate(const point &t) override;
-        void scale(const point &origin, int v) override;
-        void rotate(const point &origin, int v) override;
-        shape *duplicate() const override;
+        void record(scene &s) const override;
+        box bounds() const override;
+        void transform(const matrix &m) override;
+        shape *duplicate(arena &mem) const override;
 
     };
 
@@ -56,14 +64,56 @@ namespace svg {
 
     class rect : public polygon{
     public:
-        rect(const svg::color& fill, std::vector<point> points);
+        rect(const svg::color& fill, point *points);
 
     };
 
     class line : public polyline{
     public:
-        line(std::vector<point> points, const svg::color& stroke);
+        line(point *points, const svg::color& stroke);
 
     };
+
+    //! Group of shapes (<g> element).
+    //! Transforming a group does not touch its shapes: the transformation
+    //! is accumulated in the group and applied once to each shape when
+    //! the group is added to a scene. So is the opacity of the group,
+    //! which is applied to each shape separately (where shapes of the
+    //! group overlap, this differs from blending the group as a whole).
+    class group : public shape {
+    protected:
+        std::vector<shape *> shapes;
+        matrix group_transform;
+    public:
+        group(const std::vector<shape *> &shapes);
+        void draw(png_image &img) const override;
+        void record(scene &s) const override;
+        void record_transformed(scene &s, const matrix &m,
+                                rgb_value opacity, arena &scratch) const override;
+        box bounds() const override;
+        box transformed_bounds(const matrix &m) const override;
+        void transform(const matrix &m) override;
+        shape *duplicate(arena &mem) const override;
+    };
+
+    //! Instance of another shape (<use> element).
+    //! Instances do not copy the referenced shape: all instances share
+    //! its (immutable) geometry, and only have their own transformation,
+    //! applied when the instance is added to a scene.
+    class use : public shape {
+    protected:
+        const shape *target;
+        matrix use_transform;
+    public:
+        use(const shape *target);
+        void draw(png_image &img) const override;
+        void record(scene &s) const override;
+        void record_transformed(scene &s, const matrix &m,
+                                rgb_value opacity, arena &scratch) const override;
+        box bounds() const override;
+        box transformed_bounds(const matrix &m) const override;
+        void transform(const matrix &m) override;
+        shape *duplicate(arena &mem) const override;
+    };
 }
 #endif
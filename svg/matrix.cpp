@@ -0,0 +1,88 @@
+#include "matrix.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace svg {
+    namespace {
+        // sin(k degrees) for k in [0, 90], rounded from long double.
+        struct sine_table {
+            double v[91];
+            sine_table() {
+                const long double pi = ::acosl(-1.0L);
+                for (int k = 0; k <= 90; k++) {
+                    v[k] = (double) ::sinl(pi * k / 180);
+                }
+                v[0] = 0;
+                v[30] = 0.5;
+                v[90] = 1;
+            }
+        };
+
+#ifdef __SSE2__
+        // Round two doubles to the nearest integers, halfway cases away
+        // from zero (as lround), in the low two lanes. Adding the largest
+        // double below 0.5 and truncating gives the same results as
+        // lround for values in the range of int.
+        inline __m128i round_pd(__m128d v) {
+            const __m128d sign = _mm_set1_pd(-0.0);
+            const __m128d half = _mm_set1_pd(0.49999999999999994);
+            return _mm_cvttpd_epi32(_mm_add_pd(v, _mm_or_pd(half, _mm_and_pd(v, sign))));
+        }
+#endif
+    }
+
+    void sin_cos_degrees(double degrees, double& s, double& c) {
+        if (degrees != ::floor(degrees) || ::fabs(degrees) >= 1e9) {
+            double angle = M_PI * degrees / 180.0;
+            s = ::sin(angle);
+            c = ::cos(angle);
+            return;
+        }
+        static const sine_table table;
+        int k = (int) ((long long) degrees % 360);
+        if (k < 0) {
+            k += 360;
+        }
+        double s0 = table.v[k % 90], c0 = table.v[90 - k % 90];
+        switch (k / 90) {
+            case 0: s = s0; c = c0; break;
+            case 1: s = c0; c = -s0; break;
+            case 2: s = -s0; c = -c0; break;
+            default: s = -c0; c = s0; break;
+        }
+    }
+
+    void matrix::apply(point* points, size_t n) const {
+        size_t i = 0;
+#ifdef __SSE2__
+        // Four points at a time, with x and y in separate vectors, and
+        // computed as in apply(const point&).
+        const __m128d a2 = _mm_set1_pd(a), b2 = _mm_set1_pd(b), c2 = _mm_set1_pd(c);
+        const __m128d d2 = _mm_set1_pd(d), e2 = _mm_set1_pd(e), f2 = _mm_set1_pd(f);
+        for (; i + 4 <= n; i += 4) {
+            __m128i p0 = _mm_loadu_si128((const __m128i*) (points + i));
+            __m128i p1 = _mm_loadu_si128((const __m128i*) (points + i + 2));
+            // (x0, x1, y0, y1) and (x2, x3, y2, y3).
+            p0 = _mm_shuffle_epi32(p0, _MM_SHUFFLE(3, 1, 2, 0));
+            p1 = _mm_shuffle_epi32(p1, _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i xs = _mm_unpacklo_epi64(p0, p1);
+            __m128i ys = _mm_unpackhi_epi64(p0, p1);
+            __m128d x01 = _mm_cvtepi32_pd(xs), x23 = _mm_cvtepi32_pd(_mm_srli_si128(xs, 8));
+            __m128d y01 = _mm_cvtepi32_pd(ys), y23 = _mm_cvtepi32_pd(_mm_srli_si128(ys, 8));
+            __m128i rx = _mm_unpacklo_epi64(
+                round_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a2, x01), _mm_mul_pd(c2, y01)), e2)),
+                round_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a2, x23), _mm_mul_pd(c2, y23)), e2)));
+            __m128i ry = _mm_unpacklo_epi64(
+                round_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b2, x01), _mm_mul_pd(d2, y01)), f2)),
+                round_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b2, x23), _mm_mul_pd(d2, y23)), f2)));
+            _mm_storeu_si128((__m128i*) (points + i), _mm_unpacklo_epi32(rx, ry));
+            _mm_storeu_si128((__m128i*) (points + i + 2), _mm_unpackhi_epi32(rx, ry));
+        }
+#endif
+        for (; i < n; i++) {
+            points[i] = apply(points[i]);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+//! @file matrix.hpp
+#ifndef __svg_matrix_hpp__
+#define __svg_matrix_hpp__
+
+#include <cmath>
+#include <cstddef>
+#include "point.hpp"
+
+namespace svg {
+    //! Sine and cosine of an angle in degrees. Integer angles use a table
+    //! of exact values: 0 and 1 for multiples of 90, 0.5 for sin(30).
+    //! @param degrees Angle.
+    //! @param s Sine.
+    //! @param c Cosine.
+    void sin_cos_degrees(double degrees, double& s, double& c);
+
+    //! 2x3 affine transformation matrix, as in SVG's matrix(a b c d e f):
+    //! x' = a * x + c * y + e, y' = b * x + d * y + f.
+    struct matrix {
+        double a, b, c, d, e, f;
+
+        //! Identity transformation.
+        static matrix identity() {
+            return { 1, 0, 0, 1, 0, 0 };
+        }
+        //! Translation.
+        //! @param tx X translation.
+        //! @param ty Y translation.
+        static matrix translation(double tx, double ty) {
+            return { 1, 0, 0, 1, tx, ty };
+        }
+        //! Scaling around (0, 0).
+        //! @param sx X scale factor.
+        //! @param sy Y scale factor.
+        static matrix scaling(double sx, double sy) {
+            return { sx, 0, 0, sy, 0, 0 };
+        }
+        //! Rotation around (0, 0).
+        //! @param degrees Degrees of rotation.
+        static matrix rotation(double degrees) {
+            double s, c;
+            sin_cos_degrees(degrees, s, c);
+            return { c, s, -s, c, 0, 0 };
+        }
+        //! Skew along the X axis.
+        //! @param degrees Skew angle.
+        static matrix skew_x(double degrees) {
+            return { 1, 0, ::tan(M_PI * degrees / 180.0), 1, 0, 0 };
+        }
+        //! Skew along the Y axis.
+        //! @param degrees Skew angle.
+        static matrix skew_y(double degrees) {
+            return { 1, ::tan(M_PI * degrees / 180.0), 0, 1, 0, 0 };
+        }
+        //! Composition: the result applies m first, then this matrix.
+        //! @param m Matrix to apply first.
+        //! @return Composed matrix.
+        matrix operator*(const matrix& m) const {
+            return { a * m.a + c * m.b,
+                     b * m.a + d * m.b,
+                     a * m.c + c * m.d,
+                     b * m.c + d * m.d,
+                     a * m.e + c * m.f + e,
+                     b * m.e + d * m.f + f };
+        }
+        //! Same transformation, using another point as its origin.
+        //! @param origin Transformation origin.
+        //! @return Matrix for translate(origin) * this * translate(-origin).
+        matrix around(const point& origin) const {
+            return { a, b, c, d,
+                     origin.x - a * origin.x - c * origin.y + e,
+                     origin.y - b * origin.x - d * origin.y + f };
+        }
+        //! Check for the identity transformation.
+        bool is_identity() const {
+            return a == 1 && b == 0 && c == 0 && d == 1 && e == 0 && f == 0;
+        }
+        //! Length of the transformed unit X vector.
+        double x_scale() const {
+            return ::hypot(a, b);
+        }
+        //! Length of the transformed unit Y vector.
+        double y_scale() const {
+            return ::hypot(c, d);
+        }
+        //! Transform a point, rounding to the nearest integer
+        //! (halfway cases away from zero).
+        //! @param p Point.
+        //! @return Transformed point.
+        point apply(const point& p) const {
+            return { (int) ::lround(a * p.x + c * p.y + e),
+                     (int) ::lround(b * p.x + d * p.y + f) };
+        }
+        //! Transform an array of points in place, in a single pass.
+        //! Same results as apply for each point, four points at a time.
+        //! @param points Points.
+        //! @param n Number of points.
+        void apply(point* points, size_t n) const;
+    };
+}
+#endif
@@ -0,0 +1,121 @@
+#include "number_list.hpp"
+
+#include <cmath>
+
+namespace svg {
+    namespace {
+        bool is_separator(char c) {
+            return c == ' ' || c == ',' || c == '\t' || c == '\n' || c == '\r';
+        }
+        bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // Digits of a number, as scanned from the text.
+        struct number_text {
+            bool negative;
+            // Integer part, rounded using the first decimal digit.
+            long long whole;
+            // All digits, and the power of ten to divide them by.
+            double mantissa;
+            double scale;
+            bool has_exponent;
+            int exponent;
+
+            double value() const {
+                double v = mantissa / scale;
+                if (has_exponent) {
+                    v *= ::pow(10.0, exponent);
+                }
+                return negative ? -v : v;
+            }
+        };
+
+        bool scan_number(const char*& p, number_text& n) {
+            const char* s = p;
+            while (is_separator(*s)) {
+                s++;
+            }
+            n.negative = *s == '-';
+            if (*s == '-' || *s == '+') {
+                s++;
+            }
+            if (!is_digit(*s) && !(*s == '.' && is_digit(s[1]))) {
+                return false;
+            }
+            n.whole = 0;
+            n.mantissa = 0;
+            for (; is_digit(*s); s++) {
+                n.whole = n.whole * 10 + (*s - '0');
+                n.mantissa = n.mantissa * 10 + (*s - '0');
+            }
+            // Without an exponent only the first decimal digit
+            // matters for rounding.
+            n.scale = 1;
+            if (*s == '.') {
+                s++;
+                n.whole += *s >= '5' && *s <= '9';
+                for (; is_digit(*s); s++) {
+                    n.mantissa = n.mantissa * 10 + (*s - '0');
+                    n.scale *= 10;
+                }
+            }
+            n.has_exponent = (*s == 'e' || *s == 'E') &&
+                (is_digit(s[1]) || ((s[1] == '-' || s[1] == '+') && is_digit(s[2])));
+            n.exponent = 0;
+            if (n.has_exponent) {
+                s++;
+                bool exp_negative = *s == '-';
+                if (*s == '-' || *s == '+') {
+                    s++;
+                }
+                for (; is_digit(*s); s++) {
+                    n.exponent = n.exponent < 1000 ? n.exponent * 10 + (*s - '0') : n.exponent;
+                }
+                if (exp_negative) {
+                    n.exponent = -n.exponent;
+                }
+            }
+            p = s;
+            return true;
+        }
+    }
+
+    bool parse_number(const char*& p, int& v) {
+        number_text n;
+        if (!scan_number(p, n)) {
+            return false;
+        }
+        if (n.has_exponent) {
+            v = (int) ::lround(n.value());
+        } else {
+            v = (int) (n.negative ? -n.whole : n.whole);
+        }
+        return true;
+    }
+
+    bool parse_number(const char*& p, double& v) {
+        number_text n;
+        if (!scan_number(p, n)) {
+            return false;
+        }
+        v = n.value();
+        return true;
+    }
+
+    size_t count_numbers(const char* p) {
+        size_t n = 0;
+        int v;
+        while (parse_number(p, v)) {
+            n++;
+        }
+        return n;
+    }
+
+    void parse_points(const char* p, point* points, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            parse_number(p, points[i].x);
+            parse_number(p, points[i].y);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+//! @file number_list.hpp
+#ifndef __svg_number_list_hpp__
+#define __svg_number_list_hpp__
+
+#include <cstddef>
+#include "point.hpp"
+
+namespace svg {
+    //! Parse the next number of an SVG number list.
+    //! Leading whitespace and commas, in any mix, are skipped.
+    //! Numbers may have a sign, a fraction and an exponent, and are
+    //! rounded to the nearest integer (halfway cases away from zero).
+    //! Parsing does not allocate memory and does not depend on the locale.
+    //! @param p Position in text, advanced past the number if one is found.
+    //! @param v Parsed value.
+    //! @return true if a number was found.
+    bool parse_number(const char*& p, int& v);
+    //! Parse the next number of an SVG number list, without rounding.
+    //! @param p Position in text, advanced past the number if one is found.
+    //! @param v Parsed value.
+    //! @return true if a number was found.
+    bool parse_number(const char*& p, double& v);
+    //! Count the numbers in an SVG number list.
+    //! Counting stops at the first character that does not belong
+    //! to a number or a separator.
+    //! @param p Text.
+    //! @return Number of numbers.
+    size_t count_numbers(const char* p);
+    //! Parse a list of points ("x1,y1 x2,y2 ...").
+    //! @param p Text.
+    //! @param points Array to fill.
+    //! @param n Number of points to parse (at most count_numbers(p) / 2).
+    void parse_points(const char* p, point* points, size_t n);
+}
+#endif
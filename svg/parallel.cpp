@@ -0,0 +1,96 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace svg {
+    namespace {
+        // Tasks still pending for one thread.
+        struct task_range {
+            std::mutex lock;
+            size_t begin;
+            size_t end;
+        };
+    }
+
+    unsigned parallel_threads(size_t n, unsigned threads) {
+        if (threads == 0) {
+            threads = std::max(1U, std::thread::hardware_concurrency());
+        }
+        if (threads > n) {
+            threads = (unsigned) n;
+        }
+        return std::max(1U, threads);
+    }
+
+    void parallel_for(size_t n, unsigned threads,
+                      const std::function<void(size_t, unsigned)>& task) {
+        threads = parallel_threads(n, threads);
+        if (threads == 1) {
+            for (size_t i = 0; i < n; i++) {
+                task(i, 0);
+            }
+            return;
+        }
+        std::vector<task_range> ranges(threads);
+        for (unsigned t = 0; t < threads; t++) {
+            ranges[t].begin = n * t / threads;
+            ranges[t].end = n * (t + 1) / threads;
+        }
+        std::exception_ptr error;
+        std::mutex error_lock;
+
+        auto worker = [&](unsigned self) {
+            task_range& own = ranges[self];
+            for (;;) {
+                size_t i;
+                {
+                    std::lock_guard<std::mutex> g(own.lock);
+                    i = own.begin < own.end ? own.begin++ : n;
+                }
+                if (i == n) {
+                    // Steal the upper half of another thread's tasks.
+                    size_t begin = 0, end = 0;
+                    for (unsigned k = 1; k < threads && begin == end; k++) {
+                        task_range& victim = ranges[(self + k) % threads];
+                        std::lock_guard<std::mutex> g(victim.lock);
+                        if (victim.begin < victim.end) {
+                            begin = victim.begin + (victim.end - victim.begin) / 2;
+                            end = victim.end;
+                            victim.end = begin;
+                        }
+                    }
+                    if (begin == end) {
+                        return;
+                    }
+                    std::lock_guard<std::mutex> g(own.lock);
+                    own.begin = begin;
+                    own.end = end;
+                    continue;
+                }
+                try {
+                    task(i, self);
+                } catch (...) {
+                    std::lock_guard<std::mutex> g(error_lock);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
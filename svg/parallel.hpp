@@ -0,0 +1,27 @@
+//! @file parallel.hpp
+#ifndef __svg_parallel_hpp__
+#define __svg_parallel_hpp__
+
+#include <cstddef>
+#include <functional>
+
+namespace svg {
+    //! Run independent tasks on a pool of threads.
+    //! Each thread starts with an equal share of the tasks and, once done
+    //! with it, steals half of the remaining tasks of another thread,
+    //! so uneven tasks are balanced across threads.
+    //! If a task throws, the first exception is rethrown once all threads
+    //! have finished.
+    //! @param n Number of tasks.
+    //! @param threads Number of threads (0 for one per hardware thread).
+    //! @param task Function called once for each task index in [0, n),
+    //! along with the index of the thread running it (in [0, threads)).
+    void parallel_for(size_t n, unsigned threads,
+                      const std::function<void(size_t, unsigned)>& task);
+    //! Get the number of threads parallel_for will use.
+    //! @param n Number of tasks.
+    //! @param threads Number of threads requested (0 for one per hardware thread).
+    //! @return Number of threads.
+    unsigned parallel_threads(size_t n, unsigned threads);
+}
+#endif
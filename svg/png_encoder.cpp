@@ -0,0 +1,386 @@
+#include "png_encoder.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace svg {
+    namespace {
+        // Checksums.
+
+        uint32_t crc32(uint32_t crc, const unsigned char* p, size_t n) {
+            static uint32_t table[256];
+            static bool table_ready = [] {
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; k++) {
+                        c = c & 1 ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+                    }
+                    table[i] = c;
+                }
+                return true;
+            }();
+            (void) table_ready;
+            crc = ~crc;
+            for (size_t i = 0; i < n; i++) {
+                crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        const uint32_t adler_base = 65521;
+
+        uint32_t adler32(const unsigned char* p, size_t n) {
+            uint32_t a = 1, b = 0;
+            while (n > 0) {
+                // Sums cannot overflow in 5552 steps.
+                size_t k = std::min(n, (size_t) 5552);
+                n -= k;
+                for (; k > 0; k--) {
+                    a += *p++;
+                    b += a;
+                }
+                a %= adler_base;
+                b %= adler_base;
+            }
+            return a | (b << 16);
+        }
+
+        // Checksum of two consecutive pieces of data, from their checksums.
+        uint32_t adler32_combine(uint32_t a1, uint32_t a2, size_t len2) {
+            uint64_t rem = len2 % adler_base;
+            uint64_t sum1 = a1 & 0xFFFF;
+            uint64_t sum2 = (rem * sum1) % adler_base;
+            sum1 += (a2 & 0xFFFF) + adler_base - 1;
+            sum2 += (a1 >> 16) + (a2 >> 16) + adler_base - rem;
+            while (sum1 >= adler_base) {
+                sum1 -= adler_base;
+            }
+            while (sum2 >= adler_base) {
+                sum2 -= adler_base;
+            }
+            return (uint32_t) (sum1 | (sum2 << 16));
+        }
+
+        // Deflate bit stream (least significant bit first).
+        class bit_writer {
+        private:
+            std::vector<unsigned char>& out;
+            uint64_t bits;
+            int count;
+        public:
+            bit_writer(std::vector<unsigned char>& out) : out(out), bits(0), count(0) { }
+            void put(uint32_t v, int n) {
+                bits |= (uint64_t) v << count;
+                count += n;
+                while (count >= 8) {
+                    out.push_back((unsigned char) bits);
+                    bits >>= 8;
+                    count -= 8;
+                }
+            }
+            // Huffman codes are stored most significant bit first.
+            void put_code(uint32_t code, int n) {
+                uint32_t r = 0;
+                for (int i = 0; i < n; i++) {
+                    r = (r << 1) | ((code >> i) & 1);
+                }
+                put(r, n);
+            }
+            void align() {
+                if (count > 0) {
+                    put(0, 8 - count);
+                }
+            }
+        };
+
+        const int length_base[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        const int length_extra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        const int distance_base[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+            8193, 12289, 16385, 24577 };
+        const int distance_extra[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        const size_t window = 32768;
+        const int max_match = 258;
+
+        // Symbol with the fixed Huffman code of deflate.
+        void put_symbol(bit_writer& w, int s) {
+            if (s <= 143) {
+                w.put_code(0x30 + s, 8);
+            } else if (s <= 255) {
+                w.put_code(0x190 + s - 144, 9);
+            } else if (s <= 279) {
+                w.put_code(s - 256, 7);
+            } else {
+                w.put_code(0xC0 + s - 280, 8);
+            }
+        }
+
+        void put_match(bit_writer& w, int length, int distance) {
+            int l = (int) (std::upper_bound(length_base, length_base + 29, length) -
+                           length_base) - 1;
+            put_symbol(w, 257 + l);
+            w.put(length - length_base[l], length_extra[l]);
+            int d = (int) (std::upper_bound(distance_base, distance_base + 30, distance) -
+                           distance_base) - 1;
+            w.put_code(d, 5);
+            w.put(distance - distance_base[d], distance_extra[d]);
+        }
+
+        // Compress data[begin, end) as deflate blocks.
+        // Matches may refer to the window before begin, so that chunks
+        // compressed separately lose little compression. A chunk other
+        // than the last ends with an empty stored block, which leaves the
+        // stream byte-aligned, so that chunks can simply be concatenated.
+        void deflate_chunk(const unsigned char* data, size_t size,
+                           size_t begin, size_t end, int level, bool last,
+                           std::vector<unsigned char>& out) {
+            bit_writer w(out);
+            if (level == 0) {
+                size_t pos = begin;
+                do {
+                    size_t n = std::min(end - pos, (size_t) 65535);
+                    w.put(last && pos + n == end, 1);
+                    w.put(0, 2);
+                    w.align();
+                    w.put((uint32_t) n, 16);
+                    w.put((uint32_t) ~n & 0xFFFF, 16);
+                    out.insert(out.end(), data + pos, data + pos + n);
+                    pos += n;
+                } while (pos < end);
+                return;
+            }
+            static const int max_chain[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+            const int chain_limit = max_chain[std::min(level, 9)];
+            const int hash_bits = 15;
+            std::vector<int32_t> head(1 << hash_bits, -1);
+            size_t base = begin - std::min(begin, window);
+            std::vector<int32_t> prev(end - base);
+            auto hash = [&](size_t i) {
+                uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+                return (v * 2654435761U) >> (32 - hash_bits);
+            };
+            auto insert = [&](size_t i) {
+                if (i + 2 < size) {
+                    uint32_t h = hash(i);
+                    prev[i - base] = head[h];
+                    head[h] = (int32_t) (i - base);
+                }
+            };
+            for (size_t i = base; i < begin; i++) {
+                insert(i);
+            }
+            w.put(last, 1);
+            w.put(1, 2); // Fixed Huffman codes.
+            size_t i = begin;
+            while (i < end) {
+                int best_length = 0;
+                size_t best_distance = 0;
+                if (i + 2 < end) {
+                    int limit = (int) std::min(end - i, (size_t) max_match);
+                    int32_t candidate = head[hash(i)];
+                    for (int chain = chain_limit;
+                         candidate >= 0 && chain > 0 && i - (base + candidate) <= window;
+                         chain--) {
+                        const unsigned char* a = data + base + candidate;
+                        const unsigned char* b = data + i;
+                        if (a[best_length] == b[best_length]) {
+                            int n = 0;
+                            while (n < limit && a[n] == b[n]) {
+                                n++;
+                            }
+                            if (n > best_length) {
+                                best_length = n;
+                                best_distance = i - (base + candidate);
+                                if (n == limit) {
+                                    break;
+                                }
+                            }
+                        }
+                        candidate = prev[candidate];
+                    }
+                }
+                if (best_length >= 3) {
+                    put_match(w, best_length, (int) best_distance);
+                    for (int k = 0; k < best_length; k++) {
+                        insert(i + k);
+                    }
+                    i += best_length;
+                } else {
+                    put_symbol(w, data[i]);
+                    insert(i);
+                    i++;
+                }
+            }
+            put_symbol(w, 256);
+            if (!last) {
+                w.put(0, 3);
+                w.align();
+                w.put(0, 16);
+                w.put(0xFFFF, 16);
+            }
+            w.align();
+        }
+
+        int paeth(int a, int b, int c) {
+            int p = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc) {
+                return a;
+            }
+            return pb <= pc ? b : c;
+        }
+
+        // Filter a row with the given filter type (0 to 4).
+        // The previous row is NULL for the first row.
+        void filter_row(int type, const unsigned char* row, const unsigned char* above,
+                        size_t n, unsigned char* out) {
+            const size_t bpp = 3;
+            out[0] = (unsigned char) type;
+            out++;
+            for (size_t i = 0; i < n; i++) {
+                int a = i >= bpp ? row[i - bpp] : 0;
+                int b = above != NULL ? above[i] : 0;
+                int c = i >= bpp && above != NULL ? above[i - bpp] : 0;
+                int p;
+                switch (type) {
+                    case 1: p = a; break;
+                    case 2: p = b; break;
+                    case 3: p = (a + b) / 2; break;
+                    case 4: p = paeth(a, b, c); break;
+                    default: p = 0; break;
+                }
+                out[i] = (unsigned char) (row[i] - p);
+            }
+        }
+
+        // Sum of absolute values of filtered bytes, taken as signed.
+        long long filter_cost(const unsigned char* out, size_t n) {
+            long long cost = 0;
+            for (size_t i = 1; i <= n; i++) {
+                cost += std::abs((int) (signed char) out[i]);
+            }
+            return cost;
+        }
+
+        void put_u32(std::vector<unsigned char>& out, uint32_t v) {
+            out.push_back((unsigned char) (v >> 24));
+            out.push_back((unsigned char) (v >> 16));
+            out.push_back((unsigned char) (v >> 8));
+            out.push_back((unsigned char) v);
+        }
+
+        void put_chunk(std::vector<unsigned char>& out, const char* type,
+                       const unsigned char* data, size_t n) {
+            put_u32(out, (uint32_t) n);
+            size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data, data + n);
+            put_u32(out, crc32(0, out.data() + start, n + 4));
+        }
+    }
+
+    bool parse_png_filter(const std::string& name,
+                          png_options::filter_strategy& filter) {
+        static const char* names[] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+        for (int i = 0; i <= png_options::FILTER_ADAPTIVE; i++) {
+            if (name == names[i]) {
+                filter = (png_options::filter_strategy) i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Rows are filtered, then compressed, in chunks of rows. Both passes
+    // run on several threads: filtering a row only needs the raw previous
+    // row, and each chunk is compressed separately (see deflate_chunk).
+    void encode_png(const color* pixels, int w, int h,
+                    const png_options& options, std::vector<unsigned char>& out) {
+        const size_t row_bytes = (size_t) w * sizeof(color);
+        const size_t line = row_bytes + 1;
+        const unsigned char* raw = (const unsigned char*) pixels;
+        std::vector<unsigned char> filtered(line * h);
+        unsigned threads = parallel_threads(h, options.threads);
+        size_t rows_per_chunk = h;
+        if (threads > 1) {
+            // A few chunks per thread for balance, but large enough
+            // for the window before each chunk not to matter much.
+            size_t min_rows = (256 * 1024 + line - 1) / line;
+            rows_per_chunk = std::max(min_rows, (h + 4 * (size_t) threads - 1) / (4 * threads));
+        }
+        size_t n_chunks = (h + rows_per_chunk - 1) / rows_per_chunk;
+        parallel_for(n_chunks, options.threads, [&](size_t c, unsigned) {
+            std::vector<unsigned char> trial(line);
+            size_t last_row = std::min((size_t) h, (c + 1) * rows_per_chunk);
+            for (size_t y = c * rows_per_chunk; y < last_row; y++) {
+                const unsigned char* row = raw + y * row_bytes;
+                const unsigned char* above = y > 0 ? row - row_bytes : NULL;
+                unsigned char* dst = filtered.data() + y * line;
+                if (options.filter != png_options::FILTER_ADAPTIVE) {
+                    filter_row(options.filter, row, above, row_bytes, dst);
+                    continue;
+                }
+                long long best = -1;
+                for (int type = 0; type <= 4; type++) {
+                    filter_row(type, row, above, row_bytes, trial.data());
+                    long long cost = filter_cost(trial.data(), row_bytes);
+                    if (best < 0 || cost < best) {
+                        best = cost;
+                        std::copy(trial.begin(), trial.end(), dst);
+                    }
+                }
+            }
+        });
+        std::vector<std::vector<unsigned char>> streams(n_chunks);
+        std::vector<uint32_t> checksums(n_chunks);
+        int level = std::max(0, std::min(options.level, 9));
+        parallel_for(n_chunks, options.threads, [&](size_t c, unsigned) {
+            size_t begin = c * rows_per_chunk * line;
+            size_t end = std::min(filtered.size(), (c + 1) * rows_per_chunk * line);
+            deflate_chunk(filtered.data(), filtered.size(), begin, end, level,
+                          c + 1 == n_chunks, streams[c]);
+            checksums[c] = adler32(filtered.data() + begin, end - begin);
+        });
+
+        std::vector<unsigned char> idat;
+        size_t total = 6;
+        for (auto& s : streams) {
+            total += s.size();
+        }
+        idat.reserve(total);
+        // zlib header: deflate with a 32K window, and the level class.
+        idat.push_back(0x78);
+        idat.push_back(level <= 1 ? 0x01 : level <= 5 ? 0x5E : level == 6 ? 0x9C : 0xDA);
+        uint32_t adler = 1;
+        for (size_t c = 0; c < n_chunks; c++) {
+            idat.insert(idat.end(), streams[c].begin(), streams[c].end());
+            std::vector<unsigned char>().swap(streams[c]);
+            size_t begin = c * rows_per_chunk * line;
+            size_t end = std::min(filtered.size(), (c + 1) * rows_per_chunk * line);
+            adler = adler32_combine(adler, checksums[c], end - begin);
+        }
+        put_u32(idat, adler);
+
+        static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        out.assign(signature, signature + 8);
+        std::vector<unsigned char> header;
+        put_u32(header, (uint32_t) w);
+        put_u32(header, (uint32_t) h);
+        // 8 bits per channel, RGB, default compression, filtering and no interlace.
+        const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+        header.insert(header.end(), format, format + 5);
+        put_chunk(out, "IHDR", header.data(), header.size());
+        put_chunk(out, "IDAT", idat.data(), idat.size());
+        put_chunk(out, "IEND", NULL, 0);
+    }
+}
@@ -0,0 +1,53 @@
+//! @file png_encoder.hpp
+#ifndef __svg_png_encoder_hpp__
+#define __svg_png_encoder_hpp__
+
+#include <string>
+#include <vector>
+#include "color.hpp"
+
+namespace svg {
+    //! PNG encoding options.
+    struct png_options {
+        //! Row filter strategy.
+        enum filter_strategy {
+            FILTER_NONE,
+            FILTER_SUB,
+            FILTER_UP,
+            FILTER_AVERAGE,
+            FILTER_PAETH,
+            //! Per row, the filter giving the smallest sum of
+            //! absolute (signed) filtered bytes.
+            FILTER_ADAPTIVE
+        };
+        //! Compression level, from 0 (rows stored uncompressed)
+        //! and 1 (fastest) to 9 (smallest).
+        int level;
+        //! Row filter strategy.
+        filter_strategy filter;
+        //! Number of encoding threads (0 for one per hardware thread).
+        //! With more than one thread, rows are filtered and compressed
+        //! in chunks that are joined into a single zlib stream.
+        unsigned threads;
+
+        png_options() : level(6), filter(FILTER_ADAPTIVE), threads(1) { }
+    };
+
+    //! Parse a filter strategy name
+    //! ("none", "sub", "up", "average", "paeth" or "adaptive").
+    //! @param name Strategy name.
+    //! @param filter Parsed strategy.
+    //! @return false if the name is not known.
+    bool parse_png_filter(const std::string& name,
+                          png_options::filter_strategy& filter);
+
+    //! Encode RGB pixels as a PNG file.
+    //! @param pixels Pixels, row by row.
+    //! @param w Image width.
+    //! @param h Image height.
+    //! @param options Encoding options.
+    //! @param out Filled with the contents of the PNG file.
+    void encode_png(const color* pixels, int w, int h,
+                    const png_options& options, std::vector<unsigned char>& out);
+}
+#endif
@@ -5,42 +5,91 @@
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
 
 namespace svg {
-    png_image::png_image(const std::string& png_file_name) {
+    png_image::png_image(const std::string& png_file_name, pixel_layout layout) {
         int dummy;
-        pixels = (color*) stbi_load(png_file_name.c_str(),
-                                    &png_width, &png_height,
-                                    &dummy, 3);
+        pixel_fmt = layout;
+        pixel_bytes = layout == LAYOUT_RGBX ? 4 : 3;
+        pixels = stbi_load(png_file_name.c_str(),
+                           &png_width, &png_height,
+                           &dummy, pixel_bytes);
         if (pixels == NULL) {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        clip = { 0, 0, png_width - 1, png_height - 1 };
+        owner = true;
+        cover = NULL;
     }
-    png_image::png_image(int w, int h) {
+    png_image::png_image(int w, int h, pixel_layout layout) {
         assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(color);
-        pixels = (color*) stbi__malloc(sz);
+        pixel_fmt = layout;
+        pixel_bytes = layout == LAYOUT_RGBX ? 4 : 3;
+        size_t sz = (size_t) w * h * pixel_bytes;
+        pixels = (unsigned char*) stbi__malloc(sz);
         png_width = w;
         png_height = h;
+        clip = { 0, 0, w - 1, h - 1 };
+        owner = true;
+        cover = NULL;
         ::memset(pixels, 0xFF, sz);
     }
-    void png_image::save(const std::string& png_file_name) const {
-        stbi_write_png(png_file_name.c_str(),
-                       png_width,
-                       png_height,
-                       3,
-                       pixels,
-                       png_width * 3);
+    png_image::png_image(png_image& img, const box& area) {
+        pixels = img.pixels;
+        pixel_fmt = img.pixel_fmt;
+        pixel_bytes = img.pixel_bytes;
+        png_width = img.png_width;
+        png_height = img.png_height;
+        clip = img.clip.intersect(area);
+        owner = false;
+        cover = NULL;
+    }
+    png_image::png_image(png_image&& img) :
+            png_width(img.png_width), png_height(img.png_height),
+            pixels(img.pixels), pixel_fmt(img.pixel_fmt),
+            pixel_bytes(img.pixel_bytes), clip(img.clip), owner(img.owner),
+            cover(NULL) {
+        img.pixels = NULL;
+        img.owner = false;
+    }
+    void png_image::save(const std::string& png_file_name,
+                         const png_options& options) const {
+        std::vector<color> packed;
+        const color* rgb = (const color*) pixels;
+        if (pixel_fmt != LAYOUT_RGB) {
+            packed.resize((size_t) png_width * png_height);
+            for (size_t i = 0; i < packed.size(); i++) {
+                ::memcpy(&packed[i], pixels + i * pixel_bytes, sizeof(color));
+            }
+            rgb = packed.data();
+        }
+        std::vector<unsigned char> data;
+        encode_png(rgb, png_width, png_height, options, data);
+        FILE* f = ::fopen(png_file_name.c_str(), "wb");
+        bool ok = f != NULL && ::fwrite(data.data(), 1, data.size(), f) == data.size();
+        if (f != NULL && ::fclose(f) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            throw std::runtime_error(png_file_name + ": could not save image!");
+        }
     }
 
     png_image::~png_image() {
-        stbi_image_free(pixels);
+        if (owner) {
+            stbi_image_free(pixels);
+        }
     }
 
     int png_image::width() const {
@@ -49,131 +98,1099 @@ namespace svg {
     int png_image::height() const {
         return png_height;
     }
+    pixel_layout png_image::layout() const {
+        return pixel_fmt;
+    }
+    int png_image::pixel_size() const {
+        return pixel_bytes;
+    }
+    const unsigned char* png_image::data() const {
+        return pixels;
+    }
+    const box& png_image::clip_area() const {
+        return clip;
+    }
     color& png_image::at(int x, int y) {
         assert(x >= 0 && x < png_width);
         assert(y >= 0 && y < png_height);
-        return pixels[y * png_width + x];
+        return *(color*) (pixels + ((size_t) y * png_width + x) * pixel_bytes);
     }
     const color& png_image::at(int x, int y) const {
         assert(x >= 0 && x < png_width);
         assert(y >= 0 && y < png_height);
-        return pixels[y * png_width + x];
+        return *(const color*) (pixels + ((size_t) y * png_width + x) * pixel_bytes);
+    }
+    struct png_image::coverage {
+        struct span {
+            int y;
+            int x0;
+            int x1;
+        };
+        std::vector<span> spans;
+    };
+
+    void png_image::plot(int x, int y, const color& c) {
+        if (cover != NULL) {
+            cover->spans.push_back({ y, x, x });
+        } else {
+            at(x, y) = c;
+        }
     }
+
+    // Spans of a translucent shape may overlap (at the ends of polygon
+    // spans, along the outline, where polyline segments meet): they are
+    // sorted and merged, so that every pixel is blended exactly once.
+    template <typename F>
+    void png_image::paint(const color& c, rgb_value alpha, F draw) {
+        if (alpha == 255) {
+            draw();
+            return;
+        }
+        if (alpha == 0) {
+            return;
+        }
+        coverage cov;
+        cover = &cov;
+        draw();
+        cover = NULL;
+        auto& spans = cov.spans;
+        std::sort(spans.begin(), spans.end(),
+                  [](const coverage::span& a, const coverage::span& b) {
+                      return a.y < b.y || (a.y == b.y && a.x0 < b.x0);
+                  });
+        size_t i = 0;
+        while (i < spans.size()) {
+            coverage::span run = spans[i++];
+            while (i < spans.size() && spans[i].y == run.y && spans[i].x0 <= run.x1 + 1) {
+                run.x1 = std::max(run.x1, spans[i].x1);
+                i++;
+            }
+            blend_span(run.y, run.x0, run.x1, c, alpha);
+        }
+    }
+
+    namespace {
+        // Floor of a / b, for b > 0.
+        long long floor_div(long long a, long long b) {
+            return a >= 0 ? a / b : -((-a + b - 1) / b);
+        }
+    }
+
     void png_image::draw_line(const point& a, const point& b, const color& c) {
         //  Bresenham Algorithm.
-        int x_from = a.x;
-        int y_from = a.y;
-        int x_to = b.x;
-        int y_to = b.y;
-        int dy = y_to - y_from;
-        int dx = x_to - x_from;
-        int step_x = 1, step_y = 1;
-        if (dy < 0) {
-            dy = -dy;
-            step_y = -1;
-        }
-        if (dx < 0) {
-            dx = -dx;
-            step_x = -1;
-        }
-        dy *= 2;
-        dx *= 2;
-        at(x_from, y_from) = c;
-        if (dx > dy) {
-            int fraction = dy - (dx / 2);
-            while (x_from != x_to) {
-                if (fraction >= 0) {
-                    y_from += step_y;
-                    fraction -= dx;
-                }
-                x_from += step_x;
-                fraction += dy;
-                at(x_from, y_from) = c;
-            }
+        if (a.y == b.y) {
+            fill_span(a.y, a.x, b.x, c);
+            return;
+        }
+        // The line is walked along its major axis: pixel i (0 <= i <= n)
+        // is at major coordinate major_from + i * step_major and minor
+        // coordinate minor_from + k(i) * step_minor, where k(i) is the
+        // number of minor steps taken by Bresenham so far. k has a closed
+        // form and is monotonic, so the range of pixels inside the clipping
+        // area is found without walking the invisible part of the line.
+        long long dx = (long long) b.x - a.x;
+        long long dy = (long long) b.y - a.y;
+        int step_x = dx < 0 ? -1 : 1;
+        int step_y = dy < 0 ? -1 : 1;
+        dx = std::abs(dx);
+        dy = std::abs(dy);
+        bool x_major = dx > dy;
+        long long n = x_major ? dx : dy;
+        long long m = x_major ? dy : dx;
+        long long major_from = x_major ? a.x : a.y;
+        long long minor_from = x_major ? a.y : a.x;
+        int step_major = x_major ? step_x : step_y;
+        int step_minor = x_major ? step_y : step_x;
+        long long major_min = x_major ? clip.x_min : clip.y_min;
+        long long major_max = x_major ? clip.x_max : clip.y_max;
+        long long minor_min = x_major ? clip.y_min : clip.x_min;
+        long long minor_max = x_major ? clip.y_max : clip.x_max;
+
+        // Error term before the first step, with both deltas doubled.
+        const long long f0 = 2 * m - n;
+        auto minor_steps = [&](long long i) {
+            return i == 0 ? 0 : floor_div(f0 + (i - 1) * 2 * m, 2 * n) + 1;
+        };
+
+        // Range of i with the major coordinate inside the clipping area.
+        long long i_min, i_max;
+        if (step_major > 0) {
+            i_min = major_min - major_from;
+            i_max = major_max - major_from;
         } else {
-            int fraction = dx - (dy >> 1);
-            while (y_from != y_to) {
-                if (fraction >= 0) {
-                    x_from += step_x;
-                    fraction -= dy;
+            i_min = major_from - major_max;
+            i_max = major_from - major_min;
+        }
+        i_min = std::max(i_min, 0LL);
+        i_max = std::min(i_max, n);
+        // Range of k(i) with the minor coordinate inside the clipping area.
+        long long k_min, k_max;
+        if (step_minor > 0) {
+            k_min = minor_min - minor_from;
+            k_max = minor_max - minor_from;
+        } else {
+            k_min = minor_from - minor_max;
+            k_max = minor_from - minor_min;
+        }
+        if (i_min > i_max || k_min > k_max) {
+            return;
+        }
+        // First i with k(i) >= k_min and last i with k(i) <= k_max.
+        long long lo = i_min, hi = i_max + 1;
+        while (lo < hi) {
+            long long mid = lo + (hi - lo) / 2;
+            if (minor_steps(mid) >= k_min) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        i_min = lo;
+        lo = i_min;
+        hi = i_max + 1;
+        while (lo < hi) {
+            long long mid = lo + (hi - lo) / 2;
+            if (minor_steps(mid) > k_max) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        i_max = lo - 1;
+        if (i_min > i_max) {
+            return;
+        }
+
+        long long k = minor_steps(i_min);
+        long long fraction = f0 + i_min * 2 * m - k * 2 * n;
+        int major = (int) (major_from + i_min * step_major);
+        int minor = (int) (minor_from + k * step_minor);
+        int& x = x_major ? major : minor;
+        int& y = x_major ? minor : major;
+        plot(x, y, c);
+        for (long long i = i_min; i < i_max; i++) {
+            if (fraction >= 0) {
+                minor += step_minor;
+                fraction -= 2 * n;
+            }
+            major += step_major;
+            fraction += 2 * m;
+            plot(x, y, c);
+        }
+    }
+
+    void png_image::fill_span(int y, int x0, int x1, const color& c) {
+        if (x0 > x1) {
+            std::swap(x0, x1);
+        }
+        x0 = std::max(x0, clip.x_min);
+        x1 = std::min(x1, clip.x_max);
+        if (x0 > x1 || y < clip.y_min || y > clip.y_max) {
+            return;
+        }
+        if (cover != NULL) {
+            cover->spans.push_back({ y, x0, x1 });
+            return;
+        }
+        if (pixel_fmt == LAYOUT_RGBX) {
+            // Whole pixels, written with aligned 32-bit stores.
+            uint32_t v;
+            unsigned char* b = (unsigned char*) &v;
+            b[0] = c.red;
+            b[1] = c.green;
+            b[2] = c.blue;
+            b[3] = 0xFF;
+            uint32_t* row = (uint32_t*) (pixels + ((size_t) y * png_width + x0) * 4);
+            std::fill(row, row + (x1 - x0 + 1), v);
+            return;
+        }
+        // Write a short run pixel by pixel, then replicate the pattern
+        // with block copies of growing size (capped so that the source
+        // stays in cache).
+        const size_t max_chunk = 4096;
+        unsigned char* row = pixels + ((size_t) y * png_width + x0) * sizeof(color);
+        size_t len = (size_t) (x1 - x0 + 1) * sizeof(color);
+        size_t done = std::min(len, 16 * sizeof(color));
+        for (size_t i = 0; i < done; i += sizeof(color)) {
+            ::memcpy(row + i, &c, sizeof(color));
+        }
+        while (done < len) {
+            size_t chunk = std::min(std::min(done, max_chunk), len - done);
+            ::memcpy(row + done, row, chunk);
+            done += chunk;
+        }
+    }
+
+    void png_image::blend_span(int y, int x0, int x1, const color& c, rgb_value alpha) {
+        if (alpha == 255) {
+            fill_span(y, x0, x1, c);
+            return;
+        }
+        if (x0 > x1) {
+            std::swap(x0, x1);
+        }
+        x0 = std::max(x0, clip.x_min);
+        x1 = std::min(x1, clip.x_max);
+        if (x0 > x1 || y < clip.y_min || y > clip.y_max) {
+            return;
+        }
+        // All bytes, including the unused byte of RGBX pixels (which stays
+        // 255), are blended the same way: (v + (v >> 8)) >> 8 is v / 255
+        // rounded, for v = c * alpha + 128 + old * (255 - alpha).
+        const unsigned a = alpha, na = 255 - alpha;
+        const unsigned src[4] = { c.red, c.green, c.blue, 255 };
+        unsigned char* p = pixels + ((size_t) y * png_width + x0) * pixel_bytes;
+        size_t len = (size_t) (x1 - x0 + 1) * pixel_bytes;
+        size_t i = 0;
+#ifdef __SSE2__
+        // Byte k of a 16-byte block starting at byte i belongs to channel
+        // (i + k) % pixel_bytes: source terms are precomputed for the
+        // three possible phases of RGB pixels (RGBX blocks all have phase 0).
+        if (len >= 16) {
+            uint16_t terms[3][16];
+            for (int ph = 0; ph < 3; ph++) {
+                for (int k = 0; k < 16; k++) {
+                    terms[ph][k] = (uint16_t) (src[(ph + k) % pixel_bytes] * a + 128);
                 }
-                y_from += step_y;
-                fraction += dx;
-                at(x_from, y_from) = c;
             }
+            const __m128i vna = _mm_set1_epi16((short) na);
+            const __m128i zero = _mm_setzero_si128();
+            const size_t phase_step = 16 % pixel_bytes;
+            for (size_t phase = 0; i + 16 <= len; i += 16) {
+                const uint16_t* t = terms[phase];
+                phase += phase_step;
+                if (phase >= (size_t) pixel_bytes) {
+                    phase -= pixel_bytes;
+                }
+                __m128i d = _mm_loadu_si128((const __m128i*) (p + i));
+                __m128i lo = _mm_unpacklo_epi8(d, zero);
+                __m128i hi = _mm_unpackhi_epi8(d, zero);
+                lo = _mm_add_epi16(_mm_mullo_epi16(lo, vna), _mm_loadu_si128((const __m128i*) t));
+                hi = _mm_add_epi16(_mm_mullo_epi16(hi, vna), _mm_loadu_si128((const __m128i*) (t + 8)));
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+                _mm_storeu_si128((__m128i*) (p + i), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (int ch = (int) (i % pixel_bytes); i < len; i++) {
+            unsigned v = src[ch] * a + 128 + p[i] * na;
+            p[i] = (unsigned char) ((v + (v >> 8)) >> 8);
+            if (++ch == pixel_bytes) {
+                ch = 0;
+            }
+        }
+    }
+
+    void png_image::copy_span(int y, int x, const color* src, int n) {
+        int x0 = std::max(x, clip.x_min);
+        int x1 = std::min(x + n - 1, clip.x_max);
+        if (x0 > x1 || y < clip.y_min || y > clip.y_max) {
+            return;
+        }
+        src += x0 - x;
+        if (pixel_fmt == LAYOUT_RGB) {
+            ::memcpy(&at(x0, y), src, (size_t) (x1 - x0 + 1) * sizeof(color));
+            return;
+        }
+        // Expand to whole 32-bit pixels, which the compiler vectorizes.
+        uint32_t* dst = (uint32_t*) &at(x0, y);
+        for (int i = 0; i <= x1 - x0; i++) {
+            uint32_t v;
+            unsigned char* p = (unsigned char*) &v;
+            p[0] = src[i].red;
+            p[1] = src[i].green;
+            p[2] = src[i].blue;
+            p[3] = 0xFF;
+            dst[i] = v;
         }
     }
 
-    void png_image::draw_polygon(const std::vector<point>& points, const color& c) {
-        int x_min = width(), x_max = 0, y_min = height(), y_max = 0;
-        for (auto& p : points) {
-            x_min = std::min(x_min, p.x);
-            x_max = std::max(x_max, p.x);
+    void png_image::copy_pixels(int y, int x, const unsigned char* src, int n) {
+        int x0 = std::max(x, clip.x_min);
+        int x1 = std::min(x + n - 1, clip.x_max);
+        if (x0 > x1 || y < clip.y_min || y > clip.y_max) {
+            return;
+        }
+        src += (size_t) (x0 - x) * pixel_bytes;
+        ::memcpy(&at(x0, y), src, (size_t) (x1 - x0 + 1) * pixel_bytes);
+    }
+
+    namespace {
+        // Polygon edge for scanline conversion. The intersection with the
+        // current scanline is kept in fixed point as x + num / den,
+        // with 0 <= num < den, and stepped exactly from one row to the next.
+        struct poly_edge {
+            int y_top;
+            int y_bottom;
+            int x;
+            long long num;
+            long long den;
+            int x_step;
+            long long num_step;
+
+            poly_edge(const point& a, const point& b) {
+                const point& t = a.y < b.y ? a : b;
+                const point& u = a.y < b.y ? b : a;
+                long long dx = u.x - t.x;
+                y_top = t.y;
+                y_bottom = u.y;
+                x = t.x;
+                num = 0;
+                den = u.y - t.y;
+                x_step = (int) (dx / den);
+                num_step = dx % den;
+                if (num_step < 0) {
+                    x_step--;
+                    num_step += den;
+                }
+            }
+            // Advance the intersection by n scanlines.
+            void advance(long long n) {
+                long long q = num + n * num_step;
+                x += (int) (n * x_step + q / den);
+                num = q % den;
+            }
+            // Intersection rounded half away from zero,
+            // as round() does for the exact value.
+            int rounded_x() const {
+                return x >= 0 ? x + (2 * num >= den) : x + (2 * num > den);
+            }
+        };
+    }
+
+    void png_image::draw_polygon(const std::vector<point>& points, const color& c,
+                                 rgb_value alpha) {
+        draw_polygon(points.data(), points.size(), c, alpha);
+    }
+
+    void png_image::draw_polygon(const point* points, size_t n, const color& c,
+                                 rgb_value alpha) {
+        paint(c, alpha, [&]() { scan_polygon(points, n, c); });
+    }
+
+    void png_image::draw_polyline(const point* points, size_t n, const color& c,
+                                  rgb_value alpha) {
+        paint(c, alpha, [&]() {
+            for (size_t i = 0; i + 1 < n; i++) {
+                draw_line(points[i], points[i + 1], c);
+            }
+        });
+    }
+
+    void png_image::draw_ellipse(const point& center, const point& radius,
+                                 const color& fill, rgb_value alpha) {
+        paint(fill, alpha, [&]() { scan_ellipse(center, radius, fill); });
+    }
+
+    void png_image::scan_polygon(const point* points, size_t n, const color& c) {
+        int y_min = height(), y_max = 0;
+        for (size_t i = 0; i < n; i++) {
+            const point& p = points[i];
             y_min = std::min(y_min, p.y);
             y_max = std::max(y_max, p.y);
         }
 
-        std::vector<double> seg;
+        // Edge table, sorted by first scanline.
+        std::vector<poly_edge> edges;
+        edges.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            const point& a = points[i];
+            const point& b = points[(i + 1) % n];
+            if (a.y != b.y) {
+                edges.push_back(poly_edge(a, b));
+            }
+        }
+        std::stable_sort(edges.begin(), edges.end(),
+                         [](const poly_edge& e1, const poly_edge& e2) {
+                             return e1.y_top < e2.y_top;
+                         });
+
+        // Active edge list, walked one scanline at a time.
+        std::vector<poly_edge*> active;
+        std::vector<int> seg;
+        size_t next_edge = 0;
+        y_min = std::max(y_min, clip.y_min);
+        y_max = std::min(y_max, clip.y_max + 1);
         for (int y = y_min; y < y_max; y++) {
-            for (auto i = 0U; i < points.size(); i++) {
-                point a = points[i];
-                point b = points[(i + 1) % points.size()];
-                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y)) {
-                    continue;
+            for (; next_edge < edges.size() && edges[next_edge].y_top <= y; next_edge++) {
+                poly_edge& e = edges[next_edge];
+                if (e.y_bottom >= y) {
+                    e.advance(y - e.y_top);
+                    active.push_back(&e);
                 }
-                if (a.y != b.y) {
-                    double x_inters = (double) (y - a.y) * (b.x - a.x) / (double) (b.y - a.y) + a.x;
-                    seg.push_back(x_inters);
+            }
+            size_t n = 0;
+            for (auto e : active) {
+                if (e->y_bottom >= y) {
+                    active[n++] = e;
                 }
             }
-            std::sort(seg.begin(), seg.end());
+            active.resize(n);
+
+            // Rounding is monotonic, so sorting the rounded intersections
+            // gives the same spans as sorting the exact ones.
+            seg.clear();
+            for (auto e : active) {
+                int x = e->rounded_x();
+                auto pos = seg.end();
+                while (pos != seg.begin() && *(pos - 1) > x) {
+                    --pos;
+                }
+                seg.insert(pos, x);
+                e->advance(1);
+            }
             size_t i_s = 0;
             while ((i_s+1) < seg.size()) {
-                point a = {(int) round(seg.at(i_s)), y };
-                point b = {(int) round(seg.at(i_s + 1)), y };
-                if (a.x == b.x) {
+                if (seg[i_s] == seg[i_s + 1]) {
                     i_s ++;
-
                 } else {
-                    draw_line(a, b, c);
+                    fill_span(y, seg[i_s], seg[i_s + 1], c);
                     i_s += 2;
                 }
             }
-            seg.clear();
         }
-        for (auto i = 0U; i < points.size(); i++) {
-            draw_line(points[i], points[(i+1) % points.size()], c);
+        for (size_t i = 0; i < n; i++) {
+            draw_line(points[i], points[(i+1) % n], c);
         }
     }
 
-    void png_image::draw_ellipse
+    void png_image::scan_ellipse
     (const point& center, const point& radius, const color& fill) {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
-        int x0 = radius.x;
-        int dx = 0;
-        for (int y = 1; y <= radius.y; y++) {
-            double vy = (double) y / (double) radius.y;
-            vy *= vy;
-            int x1 = x0 - (dx - 1);
-            for (; x1 > 0; x1--) {
-                double vx = (double) x1 / (double) radius.x;
-                vx *= vx;
-                if (vx + vy <= 1) {
-                    break;
-                }
-            }
-            dx = x0 - x1;
-            x0 = x1;
-
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+        // Row y spans center.x +/- w, w being the largest value in
+        // [0, radius.x] with (w / radius.x)^2 + (y / radius.y)^2 <= 1.
+        // Only rows inside the clipping area are computed.
+        const int rx = radius.x, ry = radius.y;
+        int y_from = std::max(-ry, clip.y_min - center.y);
+        int y_to = std::min(ry, clip.y_max - center.y);
+        if (y_from > y_to) {
+            return;
+        }
+        auto inside = [&](int x, int y) {
+            double vx = (double) x / (double) rx;
+            double vy = (double) y / (double) ry;
+            return vx * vx + vy * vy <= 1;
+        };
+        // Width of a single row, searched around its floating-point value.
+        auto row_width = [&](int y) {
+            if (y == 0) {
+                return rx;
+            }
+            double vy = (double) y / (double) ry;
+            int w = (int) (rx * ::sqrt(std::max(0.0, 1 - vy * vy)));
+            w = std::max(0, std::min(rx, w));
+            while (w < rx && inside(w + 1, y)) {
+                w++;
+            }
+            while (w > 0 && !inside(w, y)) {
+                w--;
+            }
+            return w;
+        };
+        if (rx < 0 || (long long) rx * ry > (1 << 30)) {
+            // Beyond the range of the integer test below.
+            for (int y = y_from; y <= y_to; y++) {
+                int w = row_width(y);
+                fill_span(center.y + y, center.x - w, center.x + w, fill);
+            }
+            return;
+        }
+        // The test is e(w, y) = w^2 ry^2 + y^2 rx^2 - rx^2 ry^2 <= 0, with
+        // e updated incrementally: from one row to the next, w only moves
+        // by the change of width (growing up to the center row, shrinking
+        // after it). Where e is too close to 0 for the floating-point test
+        // to be exact, that test decides, so that pixels do not change.
+        const long long rx2 = (long long) rx * rx, ry2 = (long long) ry * ry;
+        const long long r2 = rx2 * ry2;
+        const long long band = r2 >> 48;
+        auto test = [&](long long e, int x, int y) {
+            return e < -band || (e <= band && inside(x, y));
+        };
+        int w = row_width(y_from);
+        long long e = (long long) w * w * ry2 + (long long) y_from * y_from * rx2 - r2;
+        for (int y = y_from; ; ) {
+            fill_span(center.y + y, center.x - w, center.x + w, fill);
+            if (y == y_to) {
+                break;
+            }
+            e += (2LL * y + 1) * rx2;
+            y++;
+            if (y <= 0) {
+                while (w < rx && test(e + (2LL * w + 1) * ry2, w + 1, y)) {
+                    e += (2LL * w + 1) * ry2;
+                    w++;
+                }
+            } else {
+                while (w > 0 && !test(e, w, y)) {
+                    e -= (2LL * w - 1) * ry2;
+                    w--;
+                }
+            }
         }
     }
 
+    // Anti-aliasing. Shapes are drawn in continuous coordinates, where
+    // pixel (x, y) is the square [x, x + 1) x [y, y + 1). Each edge adds
+    // to the cells it crosses the signed area it accounts for (as in
+    // font-rs), so that the coverage of a pixel is the sum of the cells
+    // up to it in its row. Only cells touched by an edge are stored: a row
+    // is resolved as spans of constant coverage between them, and the
+    // interior of the shape is filled with plain fill_span calls.
+    // Deltas are rounded to fixed point one by one, so sums do not depend
+    // on their order and tiles give the same pixels as whole images.
+    struct png_image::area_coverage {
+        // Fixed-point value of a fully covered pixel.
+        static const int ONE = 1 << 16;
+        // Cells stored in each row, more are linked from the row.
+        static const int SLOTS = 8;
+        // An edge crossing a pixel covers part of it (area), and all
+        // the pixels on its right in the same row (cover).
+        struct cell {
+            int x;
+            int area;
+            int cover;
+            // Index of the next linked cell of the row, or -1.
+            int next;
+        };
+        // Pixels between cells, with the sum of the cells before them.
+        struct run {
+            int x0;
+            int x1;
+            int sum;
+        };
+        // Buffers are reused by all shapes drawn by a thread: the first
+        // cells of each row of the clip area (SLOTS per row), the cells
+        // linked from the rows, the number of cells of each row and its
+        // last linked cell (all 0 and -1 between shapes), and the cells
+        // and runs of a row being resolved (or the sums of its columns,
+        // see resolve_outlined). Rows are read from contiguous slots, and
+        // only rows crossed by many edges follow links.
+        struct scratch {
+            std::vector<cell> slots;
+            std::vector<cell> cells;
+            std::vector<int> count;
+            std::vector<int> head;
+            std::vector<cell> row;
+            std::vector<run> runs;
+            std::vector<int> sums;
+        };
+        scratch& buf;
+        box clip;
+        // Rows with cells.
+        int y_lo, y_hi;
+
+        // Coverages drawn at the same time (a shape and its outline)
+        // use different buffers.
+        area_coverage(const box& clip, int buffer = 0)
+            : buf(buffers(buffer)), clip(clip), y_lo(INT_MAX), y_hi(INT_MIN) {
+            buf.cells.clear();
+            size_t rows = clip.empty() ? 0 : (size_t) (clip.y_max - clip.y_min + 1);
+            if (buf.head.size() < rows) {
+                buf.slots.resize(rows * SLOTS);
+                buf.count.resize(rows, 0);
+                buf.head.resize(rows, -1);
+            }
+        }
+        static scratch& buffers(int buffer) {
+            static thread_local scratch s[2];
+            return s[buffer];
+        }
+
+        // Opacity of a pixel with the given coverage sum.
+        static unsigned opacity(int sum, bool even_odd, unsigned alpha) {
+            unsigned cover = (unsigned) std::abs(sum);
+            if (even_odd) {
+                cover &= 2 * ONE - 1;
+                cover = cover > ONE ? 2 * ONE - cover : cover;
+            } else {
+                cover = std::min(cover, (unsigned) ONE);
+            }
+            return (cover * alpha + ONE / 2) >> 16;
+        }
+
+        // Largest integer not above v (in the range of int).
+        static int floor_int(double v) {
+            int i = (int) v;
+            return i - (v < i);
+        }
+
+        // Rounded to the nearest fixed-point value (areas and covers are
+        // within [-1, 1], so truncating after an offset rounds down).
+        static int fixed(double v) {
+            return (int) (v * ONE + (0.5 + 16 * ONE)) - 16 * ONE;
+        }
+
+        // Add a cell (fixed-point area and cover).
+        void add(int y, int x, int area, int cover) {
+            if (x > clip.x_max) {
+                return;
+            }
+            if (x < clip.x_min) {
+                // Left of the drawing area, only the cover matters.
+                x = clip.x_min;
+                area = cover;
+            }
+            if (area != 0 || cover != 0) {
+                size_t r = (size_t) (y - clip.y_min);
+                int k = buf.count[r]++;
+                if (k < SLOTS) {
+                    buf.slots[r * SLOTS + SLOTS - 1 - k] = { x, area, cover, -1 };
+                } else {
+                    buf.cells.push_back({ x, area, cover, buf.head[r] });
+                    buf.head[r] = (int) buf.cells.size() - 1;
+                }
+            }
+        }
+
+        // Sort the cells of a row by column, and return them (n of
+        // them), the row being empty afterwards. Slots are filled from
+        // the end, so that cells are sorted in the reverse order of their
+        // addition: edges add them from right to left, and polygons add
+        // the edges of their right side first, so that few cells move.
+        // Rows with linked cells are sorted in buf.row.
+        const cell* take_row(int y, size_t& n) {
+            size_t r = (size_t) (y - clip.y_min);
+            n = (size_t) buf.count[r];
+            buf.count[r] = 0;
+            auto sort = [](cell* first, cell* last, const cell& c) {
+                cell* q = last;
+                for (; q > first && (q - 1)->x > c.x; q--) {
+                    *q = *(q - 1);
+                }
+                *q = c;
+            };
+            if (n <= SLOTS) {
+                cell* first = buf.slots.data() + r * SLOTS + SLOTS - n;
+                for (size_t k = 1; k < n; k++) {
+                    if (first[k - 1].x > first[k].x) {
+                        sort(first, first + k, cell(first[k]));
+                    }
+                }
+                return first;
+            }
+            if (buf.row.size() < n) {
+                buf.row.resize(std::max<size_t>(n, 64));
+            }
+            cell* first = buf.row.data();
+            size_t m = 0;
+            for (int k = buf.head[r]; k >= 0; k = buf.cells[k].next) {
+                sort(first, first + m++, buf.cells[k]);
+            }
+            for (size_t k = 0; k < SLOTS; k++) {
+                sort(first, first + m++, buf.slots[r * SLOTS + k]);
+            }
+            buf.head[r] = -1;
+            return first;
+        }
+
+        void add_line(double x0, double y0, double x1, double y1) {
+            if (y0 == y1) {
+                return;
+            }
+            double dir = 1;
+            if (y0 > y1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+                dir = -1;
+            }
+            double dxdy = (x1 - x0) / (y1 - y0);
+            int row_from = std::max(floor_int(y0), clip.y_min);
+            int row_to = std::min(-floor_int(-y1) - 1, clip.y_max);
+            if (row_from > row_to) {
+                return;
+            }
+            y_lo = std::min(y_lo, row_from);
+            y_hi = std::max(y_hi, row_to);
+            // Row by row, from the intersection with the top of the row
+            // (xa) to the one with the bottom (xb).
+            const int full_row = dir > 0 ? ONE : -ONE;
+            const double full_row_s = 1 / std::fabs(dxdy);
+            double top = std::max((double) row_from, y0);
+            double xa = x0 + (top - y0) * dxdy;
+            int fa = floor_int(xa);
+            for (int y = row_from; y <= row_to; y++) {
+                double bottom = std::min((double) y + 1, y1);
+                double xb = x0 + (bottom - y0) * dxdy;
+                int fb = floor_int(xb);
+                double d = (bottom - top) * dir;
+                int cover = bottom - top == 1 ? full_row : fixed(d);
+                double xl, xr;
+                int xli, xri;
+                if (xa <= xb) {
+                    xl = xa;
+                    xr = xb;
+                    xli = fa;
+                    xri = fb + (xb > fb);
+                } else {
+                    xl = xb;
+                    xr = xa;
+                    xli = fb;
+                    xri = fa + (xa > fa);
+                }
+                if (xri <= xli + 1) {
+                    // Within one column: the area right of the edge.
+                    double xm = 0.5 * (xa + xb) - xli;
+                    add(y, xli, fixed(d * (1 - xm)), cover);
+                } else {
+                    // Across several columns: the edge covers a triangle
+                    // in the first and last columns, and trapezoids in
+                    // between. Cells are added from right to left, with
+                    // the part of d covered up to each column (in fixed
+                    // point, so that cells add up exactly).
+                    double s = cover == full_row ? full_row_s : 1 / (xr - xl);
+                    double xl_frac = xl - xli;
+                    double xr_frac = xr - (xri - 1);
+                    double c0 = 0.5 * s * (1 - xl_frac) * (1 - xl_frac);
+                    double c1 = s * (1.5 - xl_frac);
+                    int right = fixed(d * (1 - 0.5 * s * xr_frac * xr_frac));
+                    int x = std::min(xri - 2, clip.x_max);
+                    int done = fixed(d * (x == xli ? c0 : c1 + (x - xli - 1) * s));
+                    add(y, xri - 1, right - done, cover - done);
+                    for (; x > xli; x--) {
+                        int f = fixed(d * (x == xli + 1 ? c0 : c1 + (x - xli - 2) * s));
+                        add(y, x, done - f, done - f);
+                        done = f;
+                    }
+                    add(y, xli, done, done);
+                }
+                top = bottom;
+                xa = xb;
+                fa = fb;
+            }
+        }
+
+        // A line from p to q, one pixel wide and extended by half a pixel
+        // at both ends (or a pixel, if p and q are the same point). The
+        // rectangles of all lines have the same orientation.
+        void add_segment(const point& p, const point& q) {
+            double dx = q.x - p.x, dy = q.y - p.y;
+            double len = std::sqrt(dx * dx + dy * dy);
+            if (len > 0) {
+                dx = 0.5 * dx / len;
+                dy = 0.5 * dy / len;
+            } else {
+                dx = 0.5;
+                dy = 0;
+            }
+            double c[4][2] = { { p.x + 0.5 - dx - dy, p.y + 0.5 - dy + dx },
+                               { q.x + 0.5 + dx - dy, q.y + 0.5 + dy + dx },
+                               { q.x + 0.5 + dx + dy, q.y + 0.5 + dy - dx },
+                               { p.x + 0.5 - dx + dy, p.y + 0.5 - dy - dx } };
+            for (int k = 0; k < 4; k++) {
+                add_line(c[k][0], c[k][1], c[(k + 1) % 4][0], c[(k + 1) % 4][1]);
+            }
+        }
+    };
+
+    void png_image::resolve(area_coverage& cov, const color& c, rgb_value alpha) {
+        auto opacity = [&](int sum) {
+            return area_coverage::opacity(sum, false, alpha);
+        };
+        const uint64_t src = c.red | (uint64_t) c.green << 16 | (uint64_t) c.blue << 32;
+        // Copies of the members used in the loop (stores to pixels could
+        // change them, as far as the compiler knows).
+        const size_t bytes = (size_t) pixel_bytes;
+        const int x_end = clip.x_max + 1;
+        for (int y = cov.y_lo; y <= cov.y_hi; y++) {
+            size_t n;
+            const area_coverage::cell* first = cov.take_row(y, n);
+            const area_coverage::cell* last = first + n;
+            unsigned char* row = pixels + (size_t) y * png_width * bytes;
+            // Runs between cells are painted after the pixels of the
+            // cells, so that finding them takes no branches.
+            std::vector<area_coverage::run>& runs = cov.buf.runs;
+            if (runs.size() < n) {
+                runs.resize(std::max<size_t>(n, 64));
+            }
+            size_t m = 0;
+            int sum = 0;
+            for (const area_coverage::cell* p = first; p < last; ) {
+                const int x = p->x;
+                int area = sum;
+                for (; p < last && p->x == x; p++) {
+                    area += p->area;
+                    sum += p->cover;
+                }
+                // The pixel of the cells (cells are within the clip area),
+                // blended without branches (alpha 0 and 255 are exact),
+                // with the channels in 16-bit lanes of a 64-bit integer.
+                uint64_t a = opacity(area);
+                unsigned char* px = row + (size_t) x * bytes;
+                uint64_t v = src * a + 0x008000800080ULL +
+                             (px[0] | (uint64_t) px[1] << 16 | (uint64_t) px[2] << 32) * (255 - a);
+                v = (v + (v >> 8 & 0x00FF00FF00FFULL)) >> 8;
+                px[0] = (unsigned char) v;
+                px[1] = (unsigned char) (v >> 16);
+                px[2] = (unsigned char) (v >> 32);
+                // Pixels up to the next cell, if any.
+                int next = p < last ? p->x : x_end;
+                runs[m] = { x + 1, next - 1, sum };
+                m += next > x + 1;
+            }
+            for (size_t k = 0; k < m; k++) {
+                unsigned run = opacity(runs[k].sum);
+                if (run == 255) {
+                    fill_span(y, runs[k].x0, runs[k].x1, c);
+                } else if (run > 0) {
+                    blend_span(y, runs[k].x0, runs[k].x1, c, (rgb_value) run);
+                }
+            }
+        }
+    }
+
+    // Rows are resolved column by column, each pixel being painted with
+    // the larger of its opacities in the shape and in the outline.
+    void png_image::resolve_outlined(area_coverage& shape, area_coverage& outline,
+                                     const color& c, rgb_value alpha) {
+        area_coverage* covs[2] = { &shape, &outline };
+        std::vector<int>& sums = shape.buf.sums;
+        const int y_lo = std::min(shape.y_lo, outline.y_lo);
+        const int y_hi = std::max(shape.y_hi, outline.y_hi);
+        for (int y = y_lo; y <= y_hi; y++) {
+            // Columns from the first cell to the right of the clip area.
+            const area_coverage::cell* cells[2];
+            size_t n[2];
+            int x_lo = clip.x_max + 1;
+            for (int i = 0; i < 2; i++) {
+                cells[i] = covs[i]->take_row(y, n[i]);
+                if (n[i] > 0) {
+                    x_lo = std::min(x_lo, cells[i][0].x);
+                }
+            }
+            if (x_lo > clip.x_max) {
+                continue;
+            }
+            const int w = clip.x_max + 1 - x_lo;
+            sums.assign(3 * (size_t) w, 0);
+            int* op = sums.data();
+            int* area = op + w;
+            int* cover = area + w;
+            for (int i = 0; i < 2; i++) {
+                for (size_t k = 0; k < n[i]; k++) {
+                    const area_coverage::cell& cell = cells[i][k];
+                    area[cell.x - x_lo] += cell.area;
+                    cover[cell.x - x_lo] += cell.cover;
+                }
+                int sum = 0;
+                for (int x = 0; x < w; x++) {
+                    int a = (int) area_coverage::opacity(sum + area[x], i == 0, alpha);
+                    op[x] = std::max(op[x], a);
+                    sum += cover[x];
+                    area[x] = 0;
+                    cover[x] = 0;
+                }
+            }
+            for (int x = 0; x < w; ) {
+                int end = x + 1;
+                while (end < w && op[end] == op[x]) {
+                    end++;
+                }
+                if (op[x] == 255) {
+                    fill_span(y, x_lo + x, x_lo + end - 1, c);
+                } else if (op[x] > 0) {
+                    blend_span(y, x_lo + x, x_lo + end - 1, c, (rgb_value) op[x]);
+                }
+                x = end;
+            }
+        }
+    }
+
+    namespace {
+        struct vec {
+            double x;
+            double y;
+        };
+
+        // Sign of the cross product of b - a and c - a.
+        int orientation(const vec& a, const vec& b, const vec& c) {
+            double d = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            return (d > 0) - (d < 0);
+        }
+
+        // Whether c, on the line through a and b, is between them.
+        bool between(const vec& a, const vec& b, const vec& c) {
+            return std::min(a.x, b.x) <= c.x && c.x <= std::max(a.x, b.x) &&
+                   std::min(a.y, b.y) <= c.y && c.y <= std::max(a.y, b.y);
+        }
+
+        // Whether segments ab and cd have a point in common.
+        bool segments_meet(const vec& a, const vec& b, const vec& c, const vec& d) {
+            int o1 = orientation(a, b, c), o2 = orientation(a, b, d);
+            int o3 = orientation(c, d, a), o4 = orientation(c, d, b);
+            return (o1 != o2 && o3 != o4) ||
+                   (o1 == 0 && between(a, b, c)) || (o2 == 0 && between(a, b, d)) ||
+                   (o3 == 0 && between(c, d, a)) || (o4 == 0 && between(c, d, b));
+        }
+
+        // Whether a polygon (without repeated consecutive vertices) is
+        // simple: edges only meet at the vertex between consecutive edges,
+        // and do not fold back there. Polygons with many vertices are not
+        // checked, and considered not simple.
+        bool simple_polygon(const std::vector<vec>& v) {
+            const size_t n = v.size();
+            if (n > 64) {
+                return false;
+            }
+            for (size_t i = 0; i < n; i++) {
+                const vec& a = v[i];
+                const vec& b = v[(i + 1) % n];
+                const vec& c = v[(i + 2) % n];
+                if (orientation(a, b, c) == 0 &&
+                    (b.x - a.x) * (c.x - b.x) + (b.y - a.y) * (c.y - b.y) < 0) {
+                    return false;
+                }
+                for (size_t j = i + 2; j < n; j++) {
+                    if ((j + 1) % n != i &&
+                        segments_meet(a, b, v[j], v[(j + 1) % n])) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    // The aliased rasterizer paints pixels whose center is inside the
+    // polygon, and its outline: the polygon is grown by half a pixel,
+    // moving each edge along its normal (with miter joins, or bevels for
+    // sharp corners), and shifted to pixel centers. Where the polygon is
+    // thinner than a pixel, parts of the grown polygon overlap: they are
+    // filled with the nonzero rule for simple polygons. Other polygons
+    // are filled with the even-odd rule, as by draw_polygon, which would
+    // cancel these overlaps out: their outline is filled on its own, with
+    // the nonzero rule.
+    void png_image::draw_polygon_aa(const point* points, size_t n, const color& fill,
+                                    rgb_value alpha) {
+        if (alpha == 0) {
+            return;
+        }
+        std::vector<vec> v;
+        v.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            if (v.empty() || points[i].x != v.back().x || points[i].y != v.back().y) {
+                v.push_back({ (double) points[i].x, (double) points[i].y });
+            }
+        }
+        while (v.size() > 1 && v.back().x == v[0].x && v.back().y == v[0].y) {
+            v.pop_back();
+        }
+        double area2 = 0;
+        for (size_t i = 0; i < v.size(); i++) {
+            const vec& a = v[i];
+            const vec& b = v[(i + 1) % v.size()];
+            area2 += a.x * b.y - b.x * a.y;
+        }
+        if (v.size() < 3 || std::fabs(area2) < 1) {
+            // No area: only the outline is drawn.
+            std::vector<point> outline(points, points + n);
+            if (n > 0) {
+                outline.push_back(points[0]);
+            }
+            draw_polyline_aa(outline.data(), outline.size(), fill, alpha);
+            return;
+        }
+        const double side = area2 > 0 ? 1 : -1;
+        const size_t m = v.size();
+        std::vector<vec> normal(m);
+        for (size_t i = 0; i < m; i++) {
+            const vec& a = v[i];
+            const vec& b = v[(i + 1) % m];
+            double len = std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+            normal[i] = { side * (b.y - a.y) / len, -side * (b.x - a.x) / len };
+        }
+        std::vector<vec> grown;
+        grown.reserve(2 * m);
+        for (size_t i = 0; i < m; i++) {
+            const vec& n1 = normal[(i + m - 1) % m];
+            const vec& n2 = normal[i];
+            const vec c = { v[i].x + 0.5, v[i].y + 0.5 };
+            double k = 1 + n1.x * n2.x + n1.y * n2.y;
+            if (k >= 0.5) {
+                // Miter (up to one pixel long).
+                grown.push_back({ c.x + 0.5 * (n1.x + n2.x) / k, c.y + 0.5 * (n1.y + n2.y) / k });
+            } else if (side * (n1.x * n2.y - n1.y * n2.x) > 0 || k < 1e-9) {
+                // Bevel for sharp convex corners, and for edges going
+                // back along the previous one.
+                grown.push_back({ c.x + 0.5 * n1.x, c.y + 0.5 * n1.y });
+                grown.push_back({ c.x + 0.5 * n2.x, c.y + 0.5 * n2.y });
+            } else {
+                // Sharp concave corners: miter limited to one pixel.
+                double len = std::sqrt((n1.x + n2.x) * (n1.x + n2.x) +
+                                       (n1.y + n2.y) * (n1.y + n2.y));
+                grown.push_back({ c.x + (n1.x + n2.x) / len, c.y + (n1.y + n2.y) / len });
+            }
+        }
+        // Cells of a row are resolved in the reverse order of their
+        // addition: edges on the right side of the polygon (going down
+        // for a clockwise polygon) are added first.
+        area_coverage cov(clip);
+        const size_t g = grown.size();
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t i = 0; i < g; i++) {
+                const vec& a = grown[i];
+                const vec& b = grown[(i + 1) % g];
+                if (((b.y > a.y) == (side > 0)) == (pass == 0)) {
+                    cov.add_line(a.x, a.y, b.x, b.y);
+                }
+            }
+        }
+        if (simple_polygon(v)) {
+            resolve(cov, fill, alpha);
+            return;
+        }
+        area_coverage outline(clip, 1);
+        for (size_t i = 0; i < n; i++) {
+            outline.add_segment(points[i], points[(i + 1) % n]);
+        }
+        resolve_outlined(cov, outline, fill, alpha);
+    }
+
+    // Each segment is a one pixel wide rectangle (see add_segment), and
+    // overlaps (at joints) are resolved with the nonzero rule.
+    void png_image::draw_polyline_aa(const point* points, size_t n, const color& stroke,
+                                     rgb_value alpha) {
+        if (alpha == 0) {
+            return;
+        }
+        area_coverage cov(clip);
+        for (size_t i = 0; i + 1 < n || (n == 1 && i == 0); i++) {
+            cov.add_segment(points[i], points[n == 1 ? 0 : i + 1]);
+        }
+        resolve(cov, stroke, alpha);
+    }
+
+    // The ellipse is grown by half a pixel, like polygons, and drawn as
+    // a polygon whose edges stay within 1/20 pixel of the curve.
+    void png_image::draw_ellipse_aa(const point& center, const point& radius,
+                                    const color& fill, rgb_value alpha) {
+        if (alpha == 0) {
+            return;
+        }
+        double rx = std::abs(radius.x) + 0.5, ry = std::abs(radius.y) + 0.5;
+        double cx = center.x + 0.5, cy = center.y + 0.5;
+        if (cy + ry < clip.y_min || cy - ry > clip.y_max + 1 ||
+            cx + rx < clip.x_min || cx - rx > clip.x_max + 1) {
+            return;
+        }
+        const double tolerance = 0.05;
+        double r = std::max(rx, ry);
+        int n = r <= tolerance ? 8 :
+                (int) std::ceil(M_PI / std::acos(1 - tolerance / r));
+        n = std::max(8, std::min(n, 4096));
+        // Radii scaled so that the polygon has the area of the ellipse.
+        double scale = std::sqrt(2 * M_PI / (n * std::sin(2 * M_PI / n)));
+        rx *= scale;
+        ry *= scale;
+        area_coverage cov(clip);
+        double px = cx + rx, py = cy;
+        for (int i = 1; i <= n; i++) {
+            double t = 2 * M_PI * i / n;
+            double qx = i == n ? cx + rx : cx + rx * std::cos(t);
+            double qy = i == n ? cy : cy + ry * std::sin(t);
+            cov.add_line(px, py, qx, qy);
+            px = qx;
+            py = qy;
+        }
+        resolve(cov, fill, alpha);
+    }
 }
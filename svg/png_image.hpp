@@ -2,14 +2,27 @@
 #ifndef __svg_png_image_hpp__
 #define __svg_png_image_hpp__
 
+#include "box.hpp"
 #include "color.hpp"
 #include "point.hpp"
+#include "png_encoder.hpp"
 
 #include <string>
 #include <vector>
 
 namespace svg {
+    //! Pixel layout in memory.
+    enum pixel_layout {
+        //! 3 bytes per pixel: red, green, blue.
+        LAYOUT_RGB,
+        //! 4 bytes per pixel: red, green, blue and an unused byte (255).
+        //! Pixels are aligned, so spans are filled with whole-pixel stores.
+        LAYOUT_RGBX
+    };
+
     //! PNG image.
+    //! Pixels are stored row by row, in one of the pixel layouts;
+    //! they are packed as RGB only when saving the image.
     class png_image {
     private:
         //! Width.
@@ -17,16 +30,69 @@ namespace svg {
         //! Height.
         int png_height;
         //! Pixels.
-        color *pixels;
+        unsigned char *pixels;
+        //! Pixel layout.
+        pixel_layout pixel_fmt;
+        //! Bytes per pixel.
+        int pixel_bytes;
+        //! Drawing area, pixels outside it are never drawn.
+        box clip;
+        //! Whether the pixels belong to this image (and not to a view).
+        bool owner;
+        //! Spans covered by the translucent shape being drawn.
+        struct coverage;
+        //! Coverage being recorded, if any: drawing then records the
+        //! pixels it would paint instead of painting them.
+        coverage *cover;
+        //! Paint a pixel (or record it in the coverage).
+        void plot(int x, int y, const color& c);
+        //! Draw a shape with the given opacity. Opaque shapes are drawn
+        //! directly; other shapes are drawn to a coverage first, so that
+        //! each pixel is blended once.
+        template <typename F>
+        void paint(const color& c, rgb_value alpha, F draw);
+        //! Cells of an anti-aliased shape being drawn.
+        struct area_coverage;
+        //! Paint the pixels of an anti-aliased shape (nonzero fill rule).
+        //! @param cov Cells of the shape.
+        //! @param c Color of the shape.
+        //! @param alpha Opacity of the shape.
+        void resolve(area_coverage& cov, const color& c, rgb_value alpha);
+        //! Paint the pixels of an anti-aliased shape and of its outline,
+        //! each pixel with the larger of the two opacities.
+        //! @param shape Cells of the shape (even-odd fill rule).
+        //! @param outline Cells of the outline (nonzero fill rule).
+        //! @param c Color of the shape.
+        //! @param alpha Opacity of the shape.
+        void resolve_outlined(area_coverage& shape, area_coverage& outline, const color& c,
+                              rgb_value alpha);
+        //! Draw an opaque polygon (see draw_polygon).
+        void scan_polygon(const point* points, size_t n, const color& fill);
+        //! Draw an opaque ellipse (see draw_ellipse).
+        void scan_ellipse(const point& center, const point& radius, const color& fill);
     public:
         //! Constructor that loads image from a file.
         //! @param png_file_name File name.
-        png_image(const std::string& png_file_name);
+        //! @param layout Pixel layout.
+        png_image(const std::string& png_file_name,
+                  pixel_layout layout = LAYOUT_RGB);
         //! Constructor of blank image.
         //! Initally, all pixels will be white.
         //! @param w Image width.
         //! @param h Image height.
-        png_image(int w, int h);
+        //! @param layout Pixel layout.
+        png_image(int w, int h, pixel_layout layout = LAYOUT_RGB);
+        //! Constructor of a view over another image.
+        //! The view shares the pixels of the other image,
+        //! but draws only inside the given area.
+        //! @param img Image to draw on.
+        //! @param area Drawing area.
+        png_image(png_image& img, const box& area);
+        //! Move constructor.
+        //! @param img Image whose pixels are taken over.
+        png_image(png_image&& img);
+        png_image(const png_image&) = delete;
+        png_image& operator=(const png_image&) = delete;
         //! Destructor.
         ~png_image();
         //! Get image width.
@@ -35,6 +101,18 @@ namespace svg {
         //! Get image height.
         //! @return The image height.
         int height() const;
+        //! Get pixel layout.
+        //! @return The pixel layout.
+        pixel_layout layout() const;
+        //! Get pixel size.
+        //! @return Number of bytes per pixel.
+        int pixel_size() const;
+        //! Get pixels, row by row, pixel_size() bytes each.
+        //! @return Pointer to the first pixel.
+        const unsigned char* data() const;
+        //! Get drawing area.
+        //! @return Area of the image where drawing takes place.
+        const box& clip_area() const;
         //! Get mutable reference to image pixel.
         //! @param x X position
         //! @param y Y position.
@@ -46,23 +124,95 @@ namespace svg {
         //! @return Reference to pixel.
         const color& at(int x, int y) const;
         //! Save to output file.
+        //! Throws std::runtime_error if the file cannot be written.
         //! @param png_file_name Output file name.
-        void save(const std::string& png_file_name) const;
+        //! @param options Encoding options.
+        void save(const std::string& png_file_name,
+                  const png_options& options = png_options()) const;
         //! Draw a line defined by 2 points.
         //! @param a First point.
         //! @param b Second point.
         //! @param c Color to use for the line.
         void draw_line(const point& a, const point& b, const color& c);
+        //! Fill a horizontal run of pixels.
+        //! @param y Row of the run.
+        //! @param x0 First column of the run.
+        //! @param x1 Last column of the run (inclusive).
+        //! @param c Color to use for the run.
+        void fill_span(int y, int x0, int x1, const color& c);
+        //! Blend a color over a horizontal run of pixels (source over).
+        //! Each channel becomes (c * alpha + old * (255 - alpha)) / 255,
+        //! rounded, computed 16 bytes at a time where SSE2 is available.
+        //! @param y Row of the run.
+        //! @param x0 First column of the run.
+        //! @param x1 Last column of the run (inclusive).
+        //! @param c Color to blend.
+        //! @param alpha Opacity of the color, from 0 to 255.
+        void blend_span(int y, int x0, int x1, const color& c, rgb_value alpha);
+        //! Copy a horizontal run of pixels.
+        //! @param y Row of the run.
+        //! @param x First column of the run.
+        //! @param src Pixels to copy.
+        //! @param n Number of pixels.
+        void copy_span(int y, int x, const color* src, int n);
+        //! Copy a horizontal run of pixels stored in the layout
+        //! of this image.
+        //! @param y Row of the run.
+        //! @param x First column of the run.
+        //! @param src Pixels to copy, pixel_size() bytes each.
+        //! @param n Number of pixels.
+        void copy_pixels(int y, int x, const unsigned char* src, int n);
         //! Draw a polygon.
         //! @param points Vector of points defining the polygon.
         //! @param fill Color to use for the polygon fill.
-        void draw_polygon(const std::vector<point>& points, const color& fill);
+        //! @param alpha Opacity of the polygon.
+        void draw_polygon(const std::vector<point>& points, const color& fill,
+                          rgb_value alpha = 255);
+        //! Draw a polygon.
+        //! @param points Array of points defining the polygon.
+        //! @param n Number of points.
+        //! @param fill Color to use for the polygon fill.
+        //! @param alpha Opacity of the polygon.
+        void draw_polygon(const point* points, size_t n, const color& fill,
+                          rgb_value alpha = 255);
+        //! Draw a polyline.
+        //! @param points Array of points defining the polyline.
+        //! @param n Number of points.
+        //! @param stroke Color to use for the lines.
+        //! @param alpha Opacity of the polyline.
+        void draw_polyline(const point* points, size_t n, const color& stroke,
+                           rgb_value alpha = 255);
         //! Draw an ellipse.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
         //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
-        void draw_ellipse(const point& center, const point& radius, const color& fill);
+        //! @param alpha Opacity of the ellipse.
+        void draw_ellipse(const point& center, const point& radius, const color& fill,
+                          rgb_value alpha = 255);
+        //! Draw an anti-aliased polygon.
+        //! Pixels are painted in proportion to the area the polygon
+        //! covers, the polygon being grown by half a pixel so that it
+        //! covers the same area as draw_polygon.
+        //! @param points Array of points defining the polygon.
+        //! @param n Number of points.
+        //! @param fill Color to use for the polygon fill.
+        //! @param alpha Opacity of the polygon.
+        void draw_polygon_aa(const point* points, size_t n, const color& fill,
+                             rgb_value alpha = 255);
+        //! Draw an anti-aliased polyline, with lines one pixel wide.
+        //! @param points Array of points defining the polyline.
+        //! @param n Number of points.
+        //! @param stroke Color to use for the lines.
+        //! @param alpha Opacity of the polyline.
+        void draw_polyline_aa(const point* points, size_t n, const color& stroke,
+                              rgb_value alpha = 255);
+        //! Draw an anti-aliased ellipse.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius in X and Y axis.
+        //! @param fill Color to use for the ellipse fill.
+        //! @param alpha Opacity of the ellipse.
+        void draw_ellipse_aa(const point& center, const point& radius, const color& fill,
+                             rgb_value alpha = 255);
     };
 }
 
@@ -0,0 +1,583 @@
+#include "scene.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace svg {
+    namespace {
+        // Match equal values of a and b in the same order, as in patience
+        // diff. Common prefixes and suffixes are matched. Then values found
+        // once in each range, in the longest sequence where their
+        // positions increase in both, are matched as anchors. The ranges
+        // between anchors are then matched in the same way.
+        void match_in_order(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                            std::vector<bool>& a_matched, std::vector<bool>& b_matched) {
+            struct range {
+                size_t a0, a1, b0, b1;
+            };
+            struct occurrence {
+                size_t a_count, a_index, b_count, b_index;
+            };
+            std::vector<range> todo(1, range{ 0, a.size(), 0, b.size() });
+            std::unordered_map<uint64_t, occurrence> seen;
+            std::vector<std::pair<size_t, size_t>> unique;
+            std::vector<size_t> tails, prev;
+            while (!todo.empty()) {
+                range r = todo.back();
+                todo.pop_back();
+                for (; r.a0 < r.a1 && r.b0 < r.b1 && a[r.a0] == b[r.b0]; r.a0++, r.b0++) {
+                    a_matched[r.a0] = true;
+                    b_matched[r.b0] = true;
+                }
+                for (; r.a0 < r.a1 && r.b0 < r.b1 && a[r.a1 - 1] == b[r.b1 - 1]; r.a1--, r.b1--) {
+                    a_matched[r.a1 - 1] = true;
+                    b_matched[r.b1 - 1] = true;
+                }
+                if (r.a0 == r.a1 || r.b0 == r.b1) {
+                    continue;
+                }
+                seen.clear();
+                for (size_t i = r.a0; i < r.a1; i++) {
+                    occurrence& o = seen[a[i]];
+                    o.a_count++;
+                    o.a_index = i;
+                }
+                for (size_t j = r.b0; j < r.b1; j++) {
+                    auto o = seen.find(b[j]);
+                    if (o != seen.end()) {
+                        o->second.b_count++;
+                        o->second.b_index = j;
+                    }
+                }
+                // Unique pairs, by position in b.
+                unique.clear();
+                for (size_t j = r.b0; j < r.b1; j++) {
+                    auto o = seen.find(b[j]);
+                    if (o != seen.end() && o->second.a_count == 1 && o->second.b_count == 1) {
+                        unique.push_back({ o->second.a_index, j });
+                    }
+                }
+                if (unique.empty()) {
+                    continue;
+                }
+                // Longest increasing sequence of positions in a
+                // (patience sorting, with links to rebuild it).
+                tails.clear();
+                prev.assign(unique.size(), SIZE_MAX);
+                for (size_t k = 0; k < unique.size(); k++) {
+                    auto t = std::lower_bound(tails.begin(), tails.end(), k,
+                        [&](size_t x, size_t y) { return unique[x].first < unique[y].first; });
+                    if (t != tails.begin()) {
+                        prev[k] = *(t - 1);
+                    }
+                    if (t == tails.end()) {
+                        tails.push_back(k);
+                    } else {
+                        *t = k;
+                    }
+                }
+                size_t a_end = r.a1, b_end = r.b1;
+                for (size_t k = tails.back(); k != SIZE_MAX; k = prev[k]) {
+                    size_t i = unique[k].first, j = unique[k].second;
+                    a_matched[i] = true;
+                    b_matched[j] = true;
+                    todo.push_back({ i + 1, a_end, j + 1, b_end });
+                    a_end = i;
+                    b_end = j;
+                }
+                todo.push_back({ r.a0, a_end, r.b0, b_end });
+            }
+        }
+    }
+
+    // Pixels of a rasterized sprite, kept as runs of painted pixels
+    // so that an instance is drawn with one copy per run. Pixels are
+    // stored in the layout of the rendered image.
+    struct sprite_raster {
+        struct run {
+            int y;
+            int x;
+            int n;
+            size_t first;
+        };
+        std::vector<run> runs;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct scene::sprite_cache {
+        // Rasterized sprites, NULL for sprites that are drawn instead.
+        std::vector<std::unique_ptr<sprite_raster>> rasters;
+        // Number of rasterized sprites.
+        size_t cached;
+        // Pixel layout of the rasterized sprites.
+        pixel_layout layout;
+    };
+
+    scene::scene(int w, int h) : scene_width(w), scene_height(h), recording(0) {
+
+    }
+
+    int scene::width() const {
+        return scene_width;
+    }
+    int scene::height() const {
+        return scene_height;
+    }
+    size_t scene::size() const {
+        return commands.size();
+    }
+
+    void scene::add_command(const command& cmd) {
+        if (recording < sprites.size()) {
+            sprites[recording].commands.push_back(cmd);
+        } else {
+            commands.push_back(cmd);
+        }
+    }
+
+    void scene::add_ellipse(const color& fill, const point& center, const point& radius,
+                            const box& bounds, const box& interior, rgb_value alpha) {
+        add_command({ ELLIPSE, fill, alpha, (uint32_t) points.size(), 2,
+                      bounds, alpha == 255 ? interior : box{ 0, 0, -1, -1 } });
+        points.push_back(center);
+        points.push_back(radius);
+    }
+    void scene::add_polygon(const color& fill, const point* pts, size_t n,
+                            const box& bounds, const box& interior, rgb_value alpha) {
+        add_command({ POLYGON, fill, alpha, (uint32_t) points.size(),
+                      (uint32_t) n, bounds, alpha == 255 ? interior : box{ 0, 0, -1, -1 } });
+        points.insert(points.end(), pts, pts + n);
+    }
+    void scene::add_polyline(const color& stroke, const point* pts, size_t n,
+                             const box& bounds, rgb_value alpha) {
+        add_command({ POLYLINE, stroke, alpha, (uint32_t) points.size(),
+                      (uint32_t) n, bounds, { 0, 0, -1, -1 } });
+        points.insert(points.end(), pts, pts + n);
+    }
+
+    bool scene::find_sprite(const void* key, uint32_t& index) const {
+        auto s = sprite_keys.find(key);
+        if (s == sprite_keys.end()) {
+            return false;
+        }
+        index = s->second;
+        return true;
+    }
+    bool scene::begin_sprite(const void* key, uint32_t& index) {
+        if (recording < sprites.size()) {
+            return false;
+        }
+        index = (uint32_t) sprites.size();
+        sprites.push_back({ {}, { 0, 0, -1, -1 } });
+        sprite_keys[key] = index;
+        recording = index;
+        return true;
+    }
+    void scene::end_sprite() {
+        sprite& s = sprites[recording];
+        box b = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (auto& cmd : s.commands) {
+            b = { std::min(b.x_min, cmd.bounds.x_min), std::min(b.y_min, cmd.bounds.y_min),
+                  std::max(b.x_max, cmd.bounds.x_max), std::max(b.y_max, cmd.bounds.y_max) };
+        }
+        s.bounds = b;
+        recording = (uint32_t) sprites.size();
+    }
+    void scene::add_sprite(uint32_t index, const point& offset) {
+        const box& b = sprites[index].bounds;
+        add_command({ SPRITE, { 0, 0, 0 }, 255, (uint32_t) points.size(), index,
+                      { b.x_min + offset.x, b.y_min + offset.y,
+                        b.x_max + offset.x, b.y_max + offset.y },
+                      { 0, 0, -1, -1 } });
+        points.push_back(offset);
+    }
+
+    void scene::draw(const command& cmd, png_image& img, const sprite_cache& cache,
+                     const point& offset, bool antialias) const {
+        const point* p = points.data() + cmd.first;
+        if (cmd.type == SPRITE) {
+            point o = { offset.x + p[0].x, offset.y + p[0].y };
+            const sprite_raster* r = cache.rasters[cmd.count].get();
+            // Sprites are rasterized at x >= 0, where polygon spans round
+            // the same way at any offset; instances reaching x < 0, where
+            // spans round halfway cases the other way, are drawn instead.
+            if (r != NULL && o.x + sprites[cmd.count].bounds.x_min >= 0) {
+                for (auto& run : r->runs) {
+                    img.copy_pixels(o.y + run.y, o.x + run.x,
+                                    r->pixels.data() + run.first, run.n);
+                }
+            } else {
+                for (auto& sub : sprites[cmd.count].commands) {
+                    draw(sub, img, cache, o, antialias);
+                }
+            }
+            return;
+        }
+        std::vector<point> moved;
+        if (offset.x != 0 || offset.y != 0) {
+            moved.resize(cmd.count);
+            for (uint32_t i = 0; i < cmd.count; i++) {
+                moved[i] = p[i].translate(offset);
+            }
+            if (cmd.type == ELLIPSE) {
+                moved[1] = p[1]; // radius
+            }
+            p = moved.data();
+        }
+        if (antialias) {
+            switch (cmd.type) {
+                case ELLIPSE:
+                    img.draw_ellipse_aa(p[0], p[1], cmd.c, cmd.alpha);
+                    break;
+                case POLYGON:
+                    img.draw_polygon_aa(p, cmd.count, cmd.c, cmd.alpha);
+                    break;
+                case POLYLINE:
+                    img.draw_polyline_aa(p, cmd.count, cmd.c, cmd.alpha);
+                    break;
+                case SPRITE:
+                    break;
+            }
+            return;
+        }
+        switch (cmd.type) {
+            case ELLIPSE:
+                img.draw_ellipse(p[0], p[1], cmd.c, cmd.alpha);
+                break;
+            case POLYGON:
+                img.draw_polygon(p, cmd.count, cmd.c, cmd.alpha);
+                break;
+            case POLYLINE:
+                img.draw_polyline(p, cmd.count, cmd.c, cmd.alpha);
+                break;
+            case SPRITE:
+                break;
+        }
+    }
+
+    // Sprites with several visible instances are rasterized once, if they
+    // fit the budget. Painted pixels are found by drawing the sprite on
+    // a white and on a black background: only they are equal in both.
+    // Translucent pixels depend on the background, so sprites with
+    // translucent shapes are always drawn. Sprites are rasterized in
+    // parallel, so instances of other sprites inside them are drawn from
+    // their commands, never from rasters that may still be written.
+    void scene::rasterize_sprites(const std::vector<uint32_t>& visible,
+                                  const render_options& options,
+                                  sprite_cache& cache) const {
+        cache.rasters.resize(sprites.size());
+        std::vector<uint32_t> instances(sprites.size(), 0);
+        for (auto i : visible) {
+            if (commands[i].type == SPRITE) {
+                instances[commands[i].count]++;
+            }
+        }
+        std::vector<uint32_t> cached;
+        size_t budget = options.antialias ? 0 : options.sprite_cache;
+        for (uint32_t i = 0; i < sprites.size(); i++) {
+            const box& b = sprites[i].bounds;
+            if (instances[i] < 2 || b.empty()) {
+                continue;
+            }
+            bool opaque = true;
+            for (auto& cmd : sprites[i].commands) {
+                opaque = opaque && cmd.alpha == 255;
+            }
+            if (!opaque) {
+                continue;
+            }
+            size_t area = (size_t) (b.x_max - b.x_min + 1) * (b.y_max - b.y_min + 1);
+            if (area <= budget) {
+                budget -= area;
+                cached.push_back(i);
+            }
+        }
+        sprite_cache none;
+        none.rasters.resize(sprites.size());
+        parallel_for(cached.size(), options.threads, [&](size_t c, unsigned) {
+            const sprite& s = sprites[cached[c]];
+            int w = s.bounds.x_max - s.bounds.x_min + 1;
+            int h = s.bounds.y_max - s.bounds.y_min + 1;
+            point o = { -s.bounds.x_min, -s.bounds.y_min };
+            png_image white(w, h, cache.layout);
+            png_image black(w, h, cache.layout);
+            for (int y = 0; y < h; y++) {
+                black.fill_span(y, 0, w - 1, { 0, 0, 0 });
+            }
+            for (auto& cmd : s.commands) {
+                draw(cmd, white, none, o, false);
+                draw(cmd, black, none, o, false);
+            }
+            std::unique_ptr<sprite_raster> r(new sprite_raster);
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w;) {
+                    if (white.at(x, y) != black.at(x, y)) {
+                        x++;
+                        continue;
+                    }
+                    int x0 = x;
+                    while (x < w && white.at(x, y) == black.at(x, y)) {
+                        x++;
+                    }
+                    r->runs.push_back({ y - o.y, x0 - o.x, x - x0, r->pixels.size() });
+                    const unsigned char* from = (const unsigned char*) &white.at(x0, y);
+                    r->pixels.insert(r->pixels.end(), from,
+                                     from + (size_t) (x - x0) * white.pixel_size());
+                }
+            }
+            cache.rasters[cached[c]] = std::move(r);
+        });
+        cache.cached = cached.size();
+    }
+
+    // Occlusion culling. Going from the last command to the first, a
+    // command is hidden if its (visible) bounding box lies inside the
+    // interior box of a later command. Only the largest interiors are kept
+    // as occluders, which keeps the pass linear in the number of commands.
+    size_t scene::cull(const box& canvas, std::vector<uint32_t>& visible,
+                       int margin) const {
+        const size_t max_occluders = 8;
+        std::vector<box> occluders;
+        auto area = [](const box& b) {
+            return (long long) (b.x_max - b.x_min + 1) * (b.y_max - b.y_min + 1);
+        };
+        std::vector<bool> hidden(commands.size(), false);
+        size_t culled = 0;
+        for (size_t i = commands.size(); i-- > 0;) {
+            box b = commands[i].bounds.grow(margin).intersect(canvas);
+            hidden[i] = b.empty();
+            for (auto& o : occluders) {
+                if (o.contains(b)) {
+                    hidden[i] = true;
+                    break;
+                }
+            }
+            if (hidden[i]) {
+                culled++;
+                continue;
+            }
+            box in = commands[i].interior.grow(-margin).intersect(canvas);
+            if (in.empty()) {
+                continue;
+            }
+            if (occluders.size() < max_occluders) {
+                occluders.push_back(in);
+            } else {
+                auto smallest = std::min_element(occluders.begin(), occluders.end(),
+                    [&](const box& x, const box& y) { return area(x) < area(y); });
+                if (area(*smallest) < area(in)) {
+                    *smallest = in;
+                }
+            }
+        }
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (!hidden[i]) {
+                visible.push_back((uint32_t) i);
+            }
+        }
+        return culled;
+    }
+
+    // Rendering, either in painter's order on the whole image or,
+    // with several threads, tile by tile. Each command is binned to the
+    // tiles its bounding box overlaps and every tile draws its commands
+    // in the original order, so both modes give the same pixels.
+    // Anti-aliased shapes may paint one pixel outside their bounds.
+    void scene::render(png_image& img, const render_options& options,
+                       render_stats* stats) const {
+        if (options.tile_size <= 0) {
+            throw std::invalid_argument("tile size must be positive");
+        }
+        const box& canvas = img.clip_area();
+        const int margin = options.antialias ? 1 : 0;
+        std::vector<uint32_t> visible;
+        size_t culled = 0;
+        if (options.cull) {
+            culled = cull(canvas, visible, margin);
+        } else {
+            for (size_t i = 0; i < commands.size(); i++) {
+                visible.push_back((uint32_t) i);
+            }
+        }
+        sprite_cache cache;
+        cache.layout = img.layout();
+        rasterize_sprites(visible, options, cache);
+        if (stats != NULL) {
+            stats->shapes = commands.size();
+            stats->culled = culled;
+            stats->cached_sprites = cache.cached;
+        }
+        draw_commands(visible, img, cache, options);
+    }
+
+    // Tiles cover the drawing area of the image, starting at its corner.
+    void scene::draw_commands(const std::vector<uint32_t>& list, png_image& img,
+                              const sprite_cache& cache,
+                              const render_options& options) const {
+        const point origin = { 0, 0 };
+        if (options.threads == 1) {
+            for (auto i : list) {
+                draw(commands[i], img, cache, origin, options.antialias);
+            }
+            return;
+        }
+        const box& canvas = img.clip_area();
+        const int margin = options.antialias ? 1 : 0;
+        int ts = options.tile_size;
+        int tiles_x = (canvas.x_max - canvas.x_min + ts) / ts;
+        int tiles_y = (canvas.y_max - canvas.y_min + ts) / ts;
+        std::vector<std::vector<uint32_t>> bins(tiles_x * tiles_y);
+        for (auto i : list) {
+            box b = commands[i].bounds.grow(margin).intersect(canvas);
+            if (b.empty()) {
+                continue;
+            }
+            for (int ty = (b.y_min - canvas.y_min) / ts;
+                 ty <= (b.y_max - canvas.y_min) / ts; ty++) {
+                for (int tx = (b.x_min - canvas.x_min) / ts;
+                     tx <= (b.x_max - canvas.x_min) / ts; tx++) {
+                    bins[ty * tiles_x + tx].push_back(i);
+                }
+            }
+        }
+        parallel_for(bins.size(), options.threads, [&](size_t t, unsigned) {
+            int x0 = canvas.x_min + (int) (t % tiles_x) * ts;
+            int y0 = canvas.y_min + (int) (t / tiles_x) * ts;
+            png_image tile(img, { x0, y0, x0 + ts - 1, y0 + ts - 1 });
+            for (auto i : bins[t]) {
+                draw(commands[i], tile, cache, origin, options.antialias);
+            }
+        });
+    }
+
+    // FNV-1a hash of the command type, color, opacity and points (and, for
+    // sprite instances, of the sprite commands). Bounds are derived from
+    // the points and are left out.
+    uint64_t scene::hash(const command& cmd) const {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&](const void* data, size_t n) {
+            const unsigned char* b = (const unsigned char*) data;
+            for (size_t i = 0; i < n; i++) {
+                h = (h ^ b[i]) * 1099511628211ULL;
+            }
+        };
+        mix(&cmd.type, sizeof(cmd.type));
+        mix(&cmd.c, sizeof(cmd.c));
+        mix(&cmd.alpha, sizeof(cmd.alpha));
+        if (cmd.type != SPRITE) {
+            mix(points.data() + cmd.first, cmd.count * sizeof(point));
+        } else {
+            mix(points.data() + cmd.first, sizeof(point));
+            for (auto& sub : sprites[cmd.count].commands) {
+                uint64_t sh = hash(sub);
+                mix(&sh, sizeof(sh));
+            }
+        }
+        return h;
+    }
+
+    std::vector<box> scene::changes(const scene& previous) const {
+        size_t n_old = previous.commands.size();
+        size_t n_new = commands.size();
+        std::vector<uint64_t> h_old(n_old), h_new(n_new);
+        for (size_t i = 0; i < n_old; i++) {
+            h_old[i] = previous.hash(previous.commands[i]);
+        }
+        for (size_t i = 0; i < n_new; i++) {
+            h_new[i] = hash(commands[i]);
+        }
+        std::vector<bool> old_matched(n_old, false), new_matched(n_new, false);
+        match_in_order(h_old, h_new, old_matched, new_matched);
+        // Outside the bounding boxes of the commands left unmatched, the
+        // same (matched) commands are drawn in the same order in both
+        // scenes.
+        const box canvas = { 0, 0, scene_width - 1, scene_height - 1 };
+        std::vector<box> areas;
+        auto add = [&](box b) {
+            b = b.intersect(canvas);
+            if (b.empty()) {
+                return;
+            }
+            // Merge with overlapping areas, until none is left.
+            for (size_t i = 0; i < areas.size();) {
+                if (areas[i].intersect(b).empty()) {
+                    i++;
+                    continue;
+                }
+                b = { std::min(b.x_min, areas[i].x_min), std::min(b.y_min, areas[i].y_min),
+                      std::max(b.x_max, areas[i].x_max), std::max(b.y_max, areas[i].y_max) };
+                areas[i] = areas.back();
+                areas.pop_back();
+                i = 0;
+            }
+            areas.push_back(b);
+        };
+        for (size_t i = 0; i < n_old; i++) {
+            if (!old_matched[i]) {
+                add(previous.commands[i].bounds);
+            }
+        }
+        for (size_t i = 0; i < n_new; i++) {
+            if (!new_matched[i]) {
+                add(commands[i].bounds);
+            }
+        }
+        return areas;
+    }
+
+    std::vector<box> scene::render_changes(png_image& img, const scene& previous,
+                                           const render_options& options) const {
+        if (options.tile_size <= 0) {
+            throw std::invalid_argument("tile size must be positive");
+        }
+        std::vector<box> areas = changes(previous);
+        if (areas.empty()) {
+            return areas;
+        }
+        // Commands are culled, and sprites rasterized, once for the box
+        // around all areas; each area then draws the commands it meets.
+        const box canvas = { 0, 0, scene_width - 1, scene_height - 1 };
+        const int margin = options.antialias ? 1 : 0;
+        box all = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (auto& b : areas) {
+            b = b.grow(margin).intersect(canvas);
+            all = { std::min(all.x_min, b.x_min), std::min(all.y_min, b.y_min),
+                    std::max(all.x_max, b.x_max), std::max(all.y_max, b.y_max) };
+        }
+        std::vector<uint32_t> visible;
+        if (options.cull) {
+            cull(all.intersect(img.clip_area()), visible, margin);
+        } else {
+            for (size_t i = 0; i < commands.size(); i++) {
+                visible.push_back((uint32_t) i);
+            }
+        }
+        sprite_cache cache;
+        cache.layout = img.layout();
+        rasterize_sprites(visible, options, cache);
+        std::vector<uint32_t> list;
+        for (auto& b : areas) {
+            png_image view(img, b);
+            const box& clip = view.clip_area();
+            if (clip.empty()) {
+                continue;
+            }
+            for (int y = clip.y_min; y <= clip.y_max; y++) {
+                view.fill_span(y, clip.x_min, clip.x_max, { 255, 255, 255 });
+            }
+            list.clear();
+            for (auto i : visible) {
+                if (!commands[i].bounds.grow(margin).intersect(clip).empty()) {
+                    list.push_back(i);
+                }
+            }
+            draw_commands(list, view, cache, options);
+        }
+        return areas;
+    }
+}
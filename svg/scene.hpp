@@ -0,0 +1,250 @@
+//! @file scene.hpp
+#ifndef __svg_scene_hpp__
+#define __svg_scene_hpp__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "box.hpp"
+#include "color.hpp"
+#include "point.hpp"
+#include "png_image.hpp"
+
+namespace svg {
+    //! Rendering options.
+    struct render_options {
+        //! Number of rendering threads (0 for one per hardware thread).
+        //! With more than one thread, the image is split in tiles
+        //! that are rendered independently.
+        unsigned threads;
+        //! Tile size in pixels, for multithreaded rendering
+        //! (rendering throws std::invalid_argument if it is not positive).
+        int tile_size;
+        //! Skip shapes that are completely covered by later shapes.
+        bool cull;
+        //! Read the SVG file with the streaming parser (for svg_to_png).
+        //! Documents with <use> elements are read with the DOM parser.
+        bool streaming;
+        //! Pixel layout of the images rendered by svg::render.
+        pixel_layout layout;
+        //! Anti-aliased rendering: edge pixels are painted in proportion
+        //! to their area covered by the shape. Sprites are then not cached.
+        bool antialias;
+        //! Budget, in pixels, for sprites rasterized once and then copied
+        //! to each of their instances (0 to draw all instances).
+        size_t sprite_cache;
+
+        render_options() : threads(1), tile_size(128), cull(true),
+                           streaming(false), layout(LAYOUT_RGB),
+                           antialias(false), sprite_cache(1 << 22) { }
+    };
+
+    //! Rendering statistics.
+    struct render_stats {
+        //! Number of shapes in the document.
+        size_t shapes;
+        //! Number of shapes skipped because later shapes cover them.
+        size_t culled;
+        //! Number of sprites rasterized once for all their instances.
+        size_t cached_sprites;
+    };
+
+    //! Compiled SVG document.
+    //! The document is parsed once into a flat list of drawing commands,
+    //! with the points of all shapes in a single array, and can then be
+    //! rendered any number of times.
+    class scene {
+    public:
+        //! Drawing command type.
+        enum command_type : uint8_t {
+            ELLIPSE,
+            POLYGON,
+            POLYLINE,
+            SPRITE
+        };
+        //! Drawing command.
+        struct command {
+            //! Command type.
+            command_type type;
+            //! Fill color (stroke color for polylines).
+            color c;
+            //! Opacity, from 0 (transparent) to 255 (opaque).
+            rgb_value alpha;
+            //! Index of the first point of the shape.
+            //! Ellipses use two points: center and radius.
+            //! Sprite instances use one point: their offset.
+            uint32_t first;
+            //! Number of points of the shape.
+            //! For sprite instances, index of the sprite.
+            uint32_t count;
+            //! Bounding box.
+            box bounds;
+            //! Box of pixels all painted by the command (possibly empty).
+            box interior;
+        };
+        //! Group of commands drawn as a unit at several integer offsets.
+        struct sprite {
+            //! Drawing commands, in painter's order.
+            std::vector<command> commands;
+            //! Bounding box of the commands.
+            box bounds;
+        };
+    private:
+        //! Sprites rasterized for one rendering.
+        struct sprite_cache;
+        //! Width.
+        int scene_width;
+        //! Height.
+        int scene_height;
+        //! Drawing commands, in painter's order.
+        std::vector<command> commands;
+        //! Points of all commands.
+        std::vector<point> points;
+        //! Sprites.
+        std::vector<sprite> sprites;
+        //! Sprite of each key.
+        std::unordered_map<const void*, uint32_t> sprite_keys;
+        //! Sprite being recorded, if any (sprites.size() otherwise).
+        uint32_t recording;
+        //! Add a command, to the sprite being recorded if any.
+        void add_command(const command& cmd);
+        //! Execute a command.
+        //! @param cmd Command.
+        //! @param img Image to draw on.
+        //! @param cache Rasterized sprites.
+        //! @param offset Translation of the command.
+        //! @param antialias Draw anti-aliased shapes.
+        void draw(const command& cmd, png_image& img, const sprite_cache& cache,
+                  const point& offset, bool antialias) const;
+        //! Draw commands, in one pass or, with several threads, by tiles.
+        //! @param list Indices of the commands, in painter's order.
+        //! @param img Image to draw on (commands are clipped to its area).
+        //! @param cache Rasterized sprites.
+        //! @param options Rendering options.
+        void draw_commands(const std::vector<uint32_t>& list, png_image& img,
+                           const sprite_cache& cache,
+                           const render_options& options) const;
+        //! Rasterize the sprites of the visible commands that fit the budget.
+        void rasterize_sprites(const std::vector<uint32_t>& visible,
+                               const render_options& options,
+                               sprite_cache& cache) const;
+        //! Find commands not covered by later commands.
+        //! @param canvas Area being drawn.
+        //! @param visible Filled with the indices of visible commands.
+        //! @param margin Pixels that commands may paint outside their
+        //! bounds (and leave partially painted inside their interior).
+        //! @return Number of hidden commands.
+        size_t cull(const box& canvas, std::vector<uint32_t>& visible,
+                    int margin) const;
+        //! Hash of the contents of a command.
+        uint64_t hash(const command& cmd) const;
+    public:
+        //! Constructor of empty scene.
+        //! @param w Scene width.
+        //! @param h Scene height.
+        scene(int w, int h);
+        //! Constructor that parses an SVG file.
+        //! By default the file is loaded as a tinyxml2 document. In
+        //! streaming mode it is instead memory-mapped and read in a single
+        //! pass, adding shapes to the scene as they are read, so memory use
+        //! is bounded by the scene rather than by a document tree.
+        //! Since no shapes are kept, <use> elements are not supported
+        //! in streaming mode: when one is found, the file is loaded
+        //! again as a tinyxml2 document.
+        //! Throws std::runtime_error if the file cannot be loaded.
+        //! @param svg_file Name of SVG file.
+        //! @param streaming Use streaming mode.
+        scene(const std::string& svg_file, bool streaming = false);
+        //! Parse an SVG document held in memory.
+        //! Throws std::runtime_error if the text cannot be parsed.
+        //! @param svg_text SVG document.
+        //! @param streaming Use streaming mode (see the file constructor).
+        //! @return Scene.
+        static scene parse(const std::string& svg_text, bool streaming = false);
+        //! Get scene width.
+        //! @return The scene width.
+        int width() const;
+        //! Get scene height.
+        //! @return The scene height.
+        int height() const;
+        //! Get number of drawing commands.
+        //! @return The number of commands.
+        size_t size() const;
+        //! Add an ellipse.
+        //! @param fill Fill color.
+        //! @param center Ellipse center.
+        //! @param radius Radius in X and Y axis.
+        //! @param bounds Bounding box.
+        //! @param interior Box of pixels all painted by the ellipse.
+        //! @param alpha Opacity (translucent shapes hide no other shape).
+        void add_ellipse(const color& fill, const point& center, const point& radius,
+                         const box& bounds, const box& interior,
+                         rgb_value alpha = 255);
+        //! Add a polygon.
+        //! @param fill Fill color.
+        //! @param pts Polygon points.
+        //! @param n Number of points.
+        //! @param bounds Bounding box.
+        //! @param interior Box of pixels all painted by the polygon.
+        //! @param alpha Opacity (translucent shapes hide no other shape).
+        void add_polygon(const color& fill, const point* pts, size_t n,
+                         const box& bounds, const box& interior,
+                         rgb_value alpha = 255);
+        //! Add a polyline.
+        //! @param stroke Stroke color.
+        //! @param pts Polyline points.
+        //! @param n Number of points.
+        //! @param bounds Bounding box.
+        //! @param alpha Opacity.
+        void add_polyline(const color& stroke, const point* pts, size_t n,
+                          const box& bounds, rgb_value alpha = 255);
+        //! Find a sprite.
+        //! @param key Key identifying the sprite contents.
+        //! @param index Set to the sprite index if found.
+        //! @return true if a sprite with that key exists.
+        bool find_sprite(const void* key, uint32_t& index) const;
+        //! Start recording a sprite: commands added until end_sprite()
+        //! go to the sprite instead of the scene. Sprites do not nest.
+        //! @param key Key identifying the sprite contents.
+        //! @param index Set to the new sprite index.
+        //! @return false if a sprite is already being recorded.
+        bool begin_sprite(const void* key, uint32_t& index);
+        //! Finish recording a sprite.
+        void end_sprite();
+        //! Add an instance of a sprite.
+        //! Instances of a sprite used more than once are drawn by
+        //! rasterizing the sprite once and copying its pixels
+        //! (unless the sprite has translucent shapes).
+        //! @param index Sprite index.
+        //! @param offset Translation of the instance.
+        void add_sprite(uint32_t index, const point& offset);
+        //! Render the scene.
+        //! Commands are drawn on top of the current image contents.
+        //! Throws std::invalid_argument if the tile size is not positive.
+        //! @param img Image to draw on.
+        //! @param options Rendering options.
+        //! @param stats If not NULL, filled with rendering statistics.
+        void render(png_image& img,
+                    const render_options& options = render_options(),
+                    render_stats* stats = NULL) const;
+        //! Find the areas where the rendering of this scene may differ
+        //! from that of a previous version of it.
+        //! Commands are matched by content hash, keeping their order
+        //! (as in patience diff): commands left unmatched in either scene
+        //! have changed, and their bounding boxes are returned
+        //! (overlapping boxes are merged).
+        //! @param previous Previous scene, of the same size.
+        //! @return Changed areas, inside the scene.
+        std::vector<box> changes(const scene& previous) const;
+        //! Render the scene over the rendering of a previous version
+        //! of it, repainting only the areas returned by changes().
+        //! @param img Image with the rendering of the previous scene.
+        //! @param previous Previous scene, of the same size.
+        //! @param options Rendering options.
+        //! @return Repainted areas.
+        std::vector<box> render_changes(png_image& img, const scene& previous,
+                                        const render_options& options = render_options()) const;
+    };
+}
+#endif
@@ -1,4 +1,7 @@
 #include "shape.hpp"
+#include "arena.hpp"
+#include <algorithm>
+#include <climits>
 #include <stdexcept>
 namespace svg {
 
@@ -7,7 +10,7 @@ namespace svg {
     }
 
     // Base class for shapes.
-    shape::shape(const color &c) : s_color(c) {
+    shape::shape(const color &c) : s_color(c), s_opacity(255) {
 
     }
 
@@ -17,19 +20,68 @@ namespace svg {
     const color &shape::get_color() const {
         return s_color;
     }
+    rgb_value shape::get_opacity() const {
+        return s_opacity;
+    }
+    void shape::set_opacity(rgb_value opacity) {
+        s_opacity = opacity;
+    }
     void shape::draw(png_image &img) const {
         not_implemented("draw");
     }
+    void shape::record(scene &s) const {
+        not_implemented("record");
+    }
+    void shape::record_transformed(scene &s, const matrix &m,
+                                   rgb_value opacity, arena &scratch) const {
+        if (m.is_identity() && opacity == 255) {
+            record(s);
+            return;
+        }
+        shape *copy = duplicate(scratch);
+        copy->transform(m);
+        copy->set_opacity(multiply_alpha(get_opacity(), opacity));
+        copy->record(s);
+        scratch.reset();
+    }
+    box shape::bounds() const {
+        not_implemented("bounds");
+        return { 0, 0, -1, -1 };
+    }
+    box shape::transformed_bounds(const matrix &m) const {
+        // Bounds of the transformed corners of the box: points of the
+        // shape stay inside them, as rounding preserves the order.
+        box b = bounds();
+        if (b.empty() || m.is_identity())
+            return b;
+        point corners[4] = { { b.x_min, b.y_min }, { b.x_max, b.y_min },
+                             { b.x_max, b.y_max }, { b.x_min, b.y_max } };
+        m.apply(corners, 4);
+        b = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (const point &p : corners) {
+            b.x_min = std::min(b.x_min, p.x);
+            b.y_min = std::min(b.y_min, p.y);
+            b.x_max = std::max(b.x_max, p.x);
+            b.y_max = std::max(b.y_max, p.y);
+        }
+        return b;
+    }
+    box shape::interior() const {
+        return { 0, 0, -1, -1 };
+    }
+    void shape::transform(const matrix &m) {
+        not_implemented("transform");
+    }
     void shape::translate(const point &c) {
-        not_implemented("translate");
+        transform(matrix::translation(c.x, c.y));
     }
     void shape::scale(const point &origin, int v) {
-        not_implemented("scale");
+        transform(matrix::scaling(v, v).around(origin));
     }
     void shape::rotate(const point &origin, int v) {
-        not_implemented("rotate");
+        transform(matrix::rotation(v).around(origin));
     }
-    shape* shape::duplicate() const {
+    shape* shape::duplicate(arena& mem) const {
         not_implemented("duplicate");
         return NULL;
     }
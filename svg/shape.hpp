@@ -6,13 +6,18 @@
 #include <vector>
 #include <map>
 #include "color.hpp"
+#include "matrix.hpp"
 #include "point.hpp"
 #include "png_image.hpp"
 
 namespace svg {
+    class arena;
+    class scene;
+
     class shape {
     private:
         color s_color;
+        rgb_value s_opacity;
     public:
         //! Constructor.
         //! @param c Color to use for shape.
@@ -22,9 +27,44 @@ namespace svg {
         //! Get color associated to shape.
         //! @return Color of shape.
         const color& get_color() const;
+        //! Get opacity of shape.
+        //! @return Opacity, from 0 (transparent) to 255 (opaque).
+        rgb_value get_opacity() const;
+        //! Set opacity of shape (shapes are initially opaque).
+        //! @param opacity Opacity, from 0 (transparent) to 255 (opaque).
+        void set_opacity(rgb_value opacity);
         //! Draw shape.
         //! @param img PNG image to draw on.
         virtual void draw(png_image& img) const;
+        //! Add shape to a scene, as a drawing command.
+        //! @param s Scene to add to.
+        virtual void record(scene& s) const;
+        //! Add shape to a scene, transformed, as a drawing command.
+        //! The shape itself is not modified: a transformed copy is made
+        //! in the scratch arena, which is reset afterwards.
+        //! @param s Scene to add to.
+        //! @param m Transformation to apply.
+        //! @param opacity Opacity to apply, on top of the shape's own.
+        //! @param scratch Arena for temporary copies.
+        virtual void record_transformed(scene& s, const matrix& m,
+                                        rgb_value opacity, arena& scratch) const;
+        //! Get bounding box of shape.
+        //! @return Box containing all pixels drawn by the shape.
+        virtual box bounds() const;
+        //! Get bounding box of shape, once transformed.
+        //! The shape itself is not modified.
+        //! @param m Transformation to apply.
+        //! @return Box containing all pixels drawn by the shape, transformed
+        //! as by transform().
+        virtual box transformed_bounds(const matrix& m) const;
+        //! Get interior box of shape.
+        //! @return Box of pixels all painted by the shape with its color
+        //! (possibly empty).
+        virtual box interior() const;
+        //! Apply an affine transformation to the shape.
+        //! Each point of the shape is transformed (and rounded) once.
+        //! @param m Transformation matrix.
+        virtual void transform(const matrix& m);
         //! Translate shape.
         //! @param t translation.
         virtual void translate(const point& c);
@@ -37,10 +77,11 @@ namespace svg {
         //! @param degrees Degrees of rotation.
         virtual void rotate(const point& center, int degrees);
         //! Duplicate shape.
-        //! Function should return a newly allocated shape
+        //! Function should return a shape allocated in the given arena
         //! with the same characteristics.
+        //! @param mem Arena to allocate the duplicate in.
         //! @return Duplicate of shape.
-        virtual shape* duplicate() const;
+        virtual shape* duplicate(arena& mem) const;
     };
 
 
@@ -7,6 +7,7 @@
 #else
 #include <svg/elements.hpp>
 #endif
+#include <svg/scene.hpp>
 #include <svg/svg_to_png.hpp>
 
 #endif
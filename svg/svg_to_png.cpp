@@ -1,116 +1,166 @@
 
 #include <iostream>
 #include <tinyxml2.h>
-#include <sstream>
+#include <cstring>
+#include <unordered_map>
+#include <stdexcept>
 #include "svg_to_png.hpp"
+#include "arena.hpp"
+#include "color_parser.hpp"
 #include "elements.hpp"
+#include "number_list.hpp"
+#include "xml_stream.hpp"
 
 using namespace tinyxml2;
 
 namespace svg {
-    // Color parsing
-    const std::map<std::string, color> COLORS = {
-            {"black",  {0,   0,   0}},
-            {"white",  {255, 255, 255}},
-            {"red",    {255, 0,   0}},
-            {"green",  {0,   255, 0}},
-            {"blue",   {0,   0,   255}},
-            {"yellow", {255, 255, 0}}
-    };
+    // Transformation parsing
 
-    color parse_color(const std::string &str) {
-        color c;
-        char first_ch = str.at(0);
-        if (first_ch == '#') {
-            int v;
-            std::stringstream ss(str.substr(1));
-            ss >> std::hex >> v;
-            c.red = (v >> 16);
-            c.green = (v >> 8) & 0xFF;
-            c.blue = v & 0xFF;
-        } else {
-            c = COLORS.at(str);
+    // Parse an SVG transform list ("translate(10 20) rotate(45) ...")
+    // into a single matrix. Returns false if the list is invalid.
+    bool parse_transform_list(const char *p, matrix &m) {
+        m = matrix::identity();
+        while (true) {
+            while (*p == ' ' || *p == ',' || *p == '\t' || *p == '\n' || *p == '\r') {
+                p++;
+            }
+            if (*p == '\0') {
+                return true;
+            }
+            const char* type = p;
+            while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+                p++;
+            }
+            size_t type_len = p - type;
+            while (*p == ' ') {
+                p++;
+            }
+            if (*p != '(') {
+                return false;
+            }
+            p++;
+            double v[6];
+            size_t n = 0;
+            while (n < 6 && parse_number(p, v[n])) {
+                n++;
+            }
+            while (*p == ' ' || *p == ',') {
+                p++;
+            }
+            if (*p != ')') {
+                return false;
+            }
+            p++;
+            auto is_type = [&](const char *name) {
+                return ::strlen(name) == type_len && ::strncmp(type, name, type_len) == 0;
+            };
+            matrix t;
+            if (is_type("matrix") && n == 6) {
+                t = { v[0], v[1], v[2], v[3], v[4], v[5] };
+            } else if (is_type("translate") && (n == 1 || n == 2)) {
+                t = matrix::translation(v[0], n == 2 ? v[1] : 0);
+            } else if (is_type("scale") && (n == 1 || n == 2)) {
+                t = matrix::scaling(v[0], n == 2 ? v[1] : v[0]);
+            } else if (is_type("rotate") && (n == 1 || n == 3)) {
+                t = matrix::rotation(v[0]);
+                if (n == 3) {
+                    t = matrix::translation(v[1], v[2]) * t *
+                        matrix::translation(-v[1], -v[2]);
+                }
+            } else if (is_type("skewX") && n == 1) {
+                t = matrix::skew_x(v[0]);
+            } else if (is_type("skewY") && n == 1) {
+                t = matrix::skew_y(v[0]);
+            } else {
+                std::cout << "Unrecognised transform type: "
+                          << std::string(type, type_len) << std::endl;
+                return false;
+            }
+            m = m * t;
         }
-        return c;
     }
 
-    // Transformation parsing
-
-    void parse_transform(shape *s, XMLElement *elem) {
+    // Element parsing functions are templates so that they work both on
+    // tinyxml2 DOM elements and on tags from the streaming reader.
+    template <typename element>
+    matrix parse_transform(const element *elem) {
+        matrix m = matrix::identity();
         const char* p_t_attr = elem->Attribute("transform");
-        if (p_t_attr == NULL)
-            return; // Not defined
-        point origin{0,0};
+        if (p_t_attr == NULL || !parse_transform_list(p_t_attr, m))
+            return m; // Not defined
         const char* p_t_o_attr = elem->Attribute("transform-origin");
         if (p_t_o_attr != NULL) {
-            std::string str = p_t_o_attr;
-            std::stringstream ss(str);
-            ss >> origin.x >> origin.y;
-        }
-        std::string attr(p_t_attr);
-        for (char &c: attr) {
-            if (c == '(' || c == ')' || c == ',') {
-                c = ' ';
-            }
-        }
-        std::stringstream ss(attr);
-        std::string type;
-        ss >> type;
-        if (type == "translate") {
-            int x, y;
-            ss >> x >> y;
-            s->translate({x, y});
-        } else if (type == "scale") {
-            int v;
-            ss >> v;
-            s->scale(origin, v);
-        } else if (type == "rotate") {
-            int v;
-            ss >> v;
-            s->rotate(origin, v);
-        } else {
-            std::cout << "Unrecognised transform type: " << type << std::endl;
+            point origin{0,0};
+            parse_number(p_t_o_attr, origin.x);
+            parse_number(p_t_o_attr, origin.y);
+            m = m.around(origin);
         }
+        return m;
     }
 
-    // Point list parsing
-    void
-    parse_points(const std::string &s, std::vector<point> &points) {
-        std::stringstream ss(s);
-        std::string val;
-        while (std::getline(ss, val, ' ')) {
-            val.at(val.find(',')) = ' ';
-            std::stringstream ss2(val);
-            int x, y;
-            ss2 >> x >> y;
-            points.push_back({x, y});
-        }
+    // Parsing state for a document. Shapes, and their points, are
+    // allocated in arenas that are released all at once after parsing.
+    struct parse_context {
+        arena shapes;
+        arena points;
+        // Elements with an id, for <use> (DOM only).
+        std::unordered_map<std::string, XMLElement *> elements;
+        // Shapes already parsed for elements with an id, so that they are
+        // parsed once however many times they are used. A NULL entry
+        // marks an element being parsed, to detect reference cycles.
+        std::unordered_map<const XMLElement *, shape *> shared;
+    };
+
+    // Parse a paint attribute ("fill" or "stroke"). Its opacity combines
+    // the alpha of the color and the matching opacity attribute
+    // ("fill-opacity" or "stroke-opacity").
+    template <typename element>
+    color parse_paint(const element *elem, const char *paint,
+                      const char *paint_opacity, rgb_value &opacity) {
+        rgb_value alpha;
+        color c = parse_color(elem->Attribute(paint), alpha);
+        opacity = multiply_alpha(alpha, parse_opacity(elem->Attribute(paint_opacity)));
+        return c;
     }
 
     // Shape parsing
-    ellipse *parse_ellipse(XMLElement *elem) {
+    template <typename element>
+    ellipse *parse_ellipse(const element *elem, parse_context &ctx) {
         int cx = elem->IntAttribute("cx");
         int cy = elem->IntAttribute("cy");
         int rx = elem->IntAttribute("rx");
         int ry = elem->IntAttribute("ry");
-        color fill = parse_color(elem->Attribute("fill"));
-        return new ellipse(fill, {cx, cy}, {rx, ry});
+        rgb_value opacity;
+        color fill = parse_paint(elem, "fill", "fill-opacity", opacity);
+        ellipse *e = ctx.shapes.make<ellipse>(fill, point{cx, cy}, point{rx, ry});
+        e->set_opacity(opacity);
+        return e;
     }
     // TODO other parsing functions for elements
 
-    circle *parse_circle(XMLElement *elem) {
+    template <typename element>
+    circle *parse_circle(const element *elem, parse_context &ctx) {
         int cx = elem->IntAttribute("cx");
         int cy = elem->IntAttribute("cy");
         int r = elem->IntAttribute("r");
-        color fill = parse_color(elem->Attribute("fill"));
-        return new circle(fill, {cx, cy}, {r, r});
+        rgb_value opacity;
+        color fill = parse_paint(elem, "fill", "fill-opacity", opacity);
+        circle *c = ctx.shapes.make<circle>(fill, point{cx, cy}, point{r, r});
+        c->set_opacity(opacity);
+        return c;
     }
 
-    polygon *parse_polygon(XMLElement *elem) {
-        std::vector<point> points;
-        parse_points(elem->Attribute("points"), points);
-        color fill = parse_color(elem->Attribute("fill"));
-        return new polygon(fill,points);
+    template <typename element>
+    polygon *parse_polygon(const element *elem, parse_context &ctx) {
+        const char *attr = elem->Attribute("points");
+        size_t n = count_numbers(attr) / 2;
+        point *points = ctx.points.make_array<point>(n);
+        parse_points(attr, points, n);
+        rgb_value opacity;
+        color fill = parse_paint(elem, "fill", "fill-opacity", opacity);
+        polygon *p = ctx.shapes.make<polygon>(fill, points, n);
+        p->set_opacity(opacity);
+        return p;
     }
 
     void point_helper(point& p, int x, int y){
@@ -118,9 +168,9 @@ namespace svg {
         p.y = y;
     }
 
-    polygon *parse_rect(XMLElement *elem) {
-        point aux;
-        std::vector<point> points;
+    template <typename element>
+    polygon *parse_rect(const element *elem, parse_context &ctx) {
+        point *points = ctx.points.make_array<point>(4);
 
         /*
         ponto 0:  ponto correspondente a (cx, cy)
@@ -133,20 +183,16 @@ namespace svg {
         int width = elem->IntAttribute("width");
         int height = elem->IntAttribute("height");
 
-        point_helper(aux,cx,cy);
-        points.push_back(aux);
+        point_helper(points[0],cx,cy);
+        point_helper(points[1],cx + width - 1, cy);
+        point_helper(points[2],cx + width - 1, cy + height - 1);
+        point_helper(points[3],cx, cy + height - 1);
 
-        point_helper(aux,cx + width - 1, cy);
-        points.push_back(aux);
-
-        point_helper(aux,cx + width - 1, cy + height - 1);
-        points.push_back(aux);
-
-        point_helper(aux,cx, cy + height - 1);
-        points.push_back(aux);
-
-        color fill = parse_color(elem->Attribute("fill"));
-        return new rect(fill,points);
+        rgb_value opacity;
+        color fill = parse_paint(elem, "fill", "fill-opacity", opacity);
+        rect *r = ctx.shapes.make<rect>(fill, points);
+        r->set_opacity(opacity);
+        return r;
     }
 
     /*
@@ -154,18 +200,24 @@ namespace svg {
         fill="none" stroke="#0000ff"/>
     */
 
-    polyline *parse_polyline(XMLElement *elem) {
-        std::vector<point> points;
-        color c;
-        parse_points(elem->Attribute("points"), points);
+    template <typename element>
+    polyline *parse_polyline(const element *elem, parse_context &ctx) {
+        color c = {0, 0, 0};
+        const char *attr = elem->Attribute("points");
+        size_t n = count_numbers(attr) / 2;
+        point *points = ctx.points.make_array<point>(n);
+        parse_points(attr, points, n);
         //color fill = parse_color(elem->Attribute("fill"));
-        color stroke = parse_color(elem->Attribute("stroke"));
-        return new polyline(c,points, stroke);
+        rgb_value opacity;
+        color stroke = parse_paint(elem, "stroke", "stroke-opacity", opacity);
+        polyline *p = ctx.shapes.make<polyline>(c, points, n, stroke);
+        p->set_opacity(opacity);
+        return p;
     }
 
-    line *parse_line(XMLElement *elem) {
-        point aux;
-        std::vector<point> points;
+    template <typename element>
+    line *parse_line(const element *elem, parse_context &ctx) {
+        point *points = ctx.points.make_array<point>(2);
 
         /* <svg width="200" height="200" xmlns="http://www.w3.org/2000/svg">
     <line x1="1" y1="198" x2="1" y2="1" stroke="red"/>
@@ -178,67 +230,305 @@ namespace svg {
         int cx2 = elem->IntAttribute("x2");
         int cy2 = elem->IntAttribute("y2");
 
-        point_helper(aux,cx1,cy1);
-        points.push_back(aux);
-        point_helper(aux,cx2,cy2);
-        points.push_back(aux);
-        color stroke = parse_color(elem->Attribute("stroke"));
+        point_helper(points[0],cx1,cy1);
+        point_helper(points[1],cx2,cy2);
+        rgb_value opacity;
+        color stroke = parse_paint(elem, "stroke", "stroke-opacity", opacity);
 
-        return new line(points, stroke);
+        line *l = ctx.shapes.make<line>(points, stroke);
+        l->set_opacity(opacity);
+        return l;
+    }
+
+    // Parse a shape element, in its own coordinates: its transform list
+    // is left to the caller, so that it is composed with the
+    // transformations of its parents and applied once.
+    // The element's opacity is combined with that of its parent.
+    // Returns NULL (after a message) for unrecognized elements.
+    template <typename element>
+    shape *parse_shape(const element *elem, parse_context &ctx,
+                       rgb_value parent_opacity = 255) {
+        std::string type(elem->Name());
+        shape *s;
+        if (type == "ellipse") {
+            s = parse_ellipse(elem, ctx);
+        } else if (type == "circle"){
+            s = parse_circle(elem, ctx);
+        } else if (type == "polygon") {
+            s = parse_polygon(elem, ctx);
+        } else if (type == "rect") {
+            s = parse_rect(elem, ctx);
+        } else if (type == "polyline") {
+            s = parse_polyline(elem, ctx);
+        } else if (type == "line") {
+            s = parse_line(elem, ctx);
+        } else {
+            std::cout << "Unrecognized shape type: " << type << std::endl;
+            return NULL;
+        }
+        rgb_value opacity = multiply_alpha(parent_opacity,
+                                           parse_opacity(elem->Attribute("opacity")));
+        s->set_opacity(multiply_alpha(s->get_opacity(), opacity));
+        return s;
+    }
+
+    void parse_shapes(XMLElement *elem, std::vector<shape *> &shapes,
+                      parse_context &ctx);
+    shape *parse_element(XMLElement *elem, parse_context &ctx);
+
+    // Groups keep their shapes in local coordinates, and only record
+    // their own transformation: it is applied to each shape once, when
+    // the group is added to the scene, however deep the nesting.
+    group *parse_group(XMLElement *elem, parse_context &ctx) {
+        std::vector<shape *> shapes;
+        parse_shapes(elem, shapes, ctx);
+        group *g = ctx.shapes.make<group>(shapes);
+        g->transform(parse_transform(elem));
+        g->set_opacity(parse_opacity(elem->Attribute("opacity")));
+        return g;
+    }
+
+    // Instances share the shape of the referenced element, which is
+    // parsed only once, and only record their own transformation.
+    use *parse_use(XMLElement *elem, parse_context &ctx) {
+        const char *href = elem->Attribute("href");
+        if (href == NULL)
+            href = elem->Attribute("xlink:href");
+        if (href == NULL || *href != '#') {
+            std::cout << "Invalid use reference" << std::endl;
+            return NULL;
+        }
+        auto target = ctx.elements.find(href + 1);
+        if (target == ctx.elements.end()) {
+            std::cout << "Unknown use reference: " << href << std::endl;
+            return NULL;
+        }
+        shape *s = parse_element(target->second, ctx);
+        if (s == NULL)
+            return NULL;
+        use *u = ctx.shapes.make<use>(s);
+        matrix m = parse_transform(elem) *
+                   matrix::translation(elem->IntAttribute("x"),
+                                       elem->IntAttribute("y"));
+        u->transform(m);
+        u->set_opacity(parse_opacity(elem->Attribute("opacity")));
+        return u;
+    }
+
+    // Parse any element: group, instance or shape.
+    // Elements with an id are parsed once and then shared.
+    shape *parse_element(XMLElement *elem, parse_context &ctx) {
+        bool has_id = elem->Attribute("id") != NULL;
+        if (has_id) {
+            auto p = ctx.shared.find(elem);
+            if (p != ctx.shared.end()) {
+                if (p->second == NULL)
+                    std::cout << "Circular use reference: "
+                              << elem->Attribute("id") << std::endl;
+                return p->second;
+            }
+            ctx.shared[elem] = NULL;
+        }
+        shape *s;
+        if (::strcmp(elem->Name(), "g") == 0) {
+            s = parse_group(elem, ctx);
+        } else if (::strcmp(elem->Name(), "use") == 0) {
+            s = parse_use(elem, ctx);
+        } else {
+            s = parse_shape(elem, ctx);
+            // A transformed shape is kept in a group of its own, like
+            // shapes in groups, so that its transformation is composed
+            // with those of the groups and instances it is drawn by.
+            matrix m = parse_transform(elem);
+            if (s != NULL && !m.is_identity()) {
+                group *g = ctx.shapes.make<group>(std::vector<shape *>(1, s));
+                g->transform(m);
+                s = g;
+            }
+        }
+        if (has_id)
+            ctx.shared[elem] = s;
+        return s;
     }
 
     // Loop for parsing shapes
-    void parse_shapes(XMLElement *elem, std::vector<shape *> &shapes) {
+    void parse_shapes(XMLElement *elem, std::vector<shape *> &shapes,
+                      parse_context &ctx) {
         for (auto child_elem = elem->FirstChildElement();
              child_elem != NULL;
              child_elem = child_elem->NextSiblingElement()) {
-            std::string type(child_elem->Name());
-            shape *s;
-            // TODO complete
-            if (type == "ellipse") {
-                s = parse_ellipse(child_elem);
-            } else if (type == "circle"){
-                s = parse_circle(child_elem);
-            } else if (type == "polygon") {
-                s = parse_polygon(child_elem);
-            } else if (type == "rect") {
-                s = parse_rect(child_elem);
-            } else if (type == "polyline") {
-                s = parse_polyline(child_elem);
-            } else if (type == "line") {
-                s = parse_line(child_elem);
-            }
-
-            else {
-                std::cout << "Unrecognized shape type: " << type << std::endl;
-                continue;
+            shape *s = parse_element(child_elem, ctx);
+            if (s != NULL) {
+                shapes.push_back(s);
             }
-            parse_transform(s, child_elem);
-            shapes.push_back(s);
         }
     }
 
-    // Main conversion function.
-    // TODO adapt if necessary
-    void svg_to_png(const std::string &svg_file, const std::string &png_file) {
-        XMLDocument doc;
-        XMLError r = doc.LoadFile(svg_file.c_str());
-        if (r != XML_SUCCESS) {
-            return;
+    // Build the index of elements with an id, in one pass over the document.
+    void index_elements(XMLElement *elem, parse_context &ctx) {
+        for (auto child_elem = elem->FirstChildElement();
+             child_elem != NULL;
+             child_elem = child_elem->NextSiblingElement()) {
+            const char *id = child_elem->Attribute("id");
+            if (id != NULL)
+                ctx.elements.emplace(id, child_elem);
+            index_elements(child_elem, ctx);
         }
-        XMLElement *elem = doc.RootElement();
+    }
+
+    // Scene loading, from the tinyxml2 DOM.
+    void load_dom(const XMLDocument &doc, scene &sc) {
+        XMLElement *elem = const_cast<XMLElement *>(doc.RootElement());
+        sc = scene(elem->IntAttribute("width"), elem->IntAttribute("height"));
+        parse_context ctx;
+        index_elements(elem, ctx);
         std::vector<shape *> shapes;
-        parse_shapes(elem, shapes);
-        int width = elem->IntAttribute("width");
-        int height = elem->IntAttribute("height");
-        png_image img(width, height);
+        parse_shapes(elem, shapes, ctx);
+        // Groups, <use> elements and transformed shapes record transformed
+        // copies: one scratch arena is shared by all of them.
+        arena scratch;
         for (auto s: shapes) {
-            s->draw(img);
+            s->record_transformed(sc, matrix::identity(), 255, scratch);
         }
-        img.save(png_file);
-        for (auto s: shapes) {
-            delete s;
+    }
+
+    // Thrown by load_stream for documents it cannot load in one pass
+    // (those with <use> elements, which may refer to later elements).
+    struct needs_dom { };
+
+    // Scene loading, in one pass over the text (usually a memory-mapped file).
+    // Each shape is added to the scene as soon as it is read and its
+    // memory is then reused, so no document tree is ever built.
+    // Groups are not kept either: the transformation and opacity of each
+    // open element are kept in a stack, and shapes are transformed once by
+    // the transformation of their parent. As with the DOM, only children
+    // of the root element and of groups are parsed.
+    // Throws std::runtime_error for malformed XML, and needs_dom for
+    // documents with <use> elements.
+    void load_stream(const char *data, size_t size, scene &sc) {
+        xml_reader reader(data, size);
+        xml_tag tag;
+        parse_context ctx;
+        struct open_element {
+            matrix transform;
+            rgb_value opacity;
+            bool container;
+        };
+        std::vector<open_element> open;
+        bool root_seen = false;
+        int depth = 0;
+        for (;;) {
+            xml_reader::event e = reader.next(tag);
+            if (e == xml_reader::DONE) {
+                break;
+            }
+            if (e == xml_reader::END) {
+                if (depth == 0) {
+                    throw std::runtime_error("malformed XML");
+                }
+                depth--;
+                if (depth > 0) {
+                    open.pop_back();
+                }
+                continue;
+            }
+            depth++;
+            if (depth == 1) {
+                if (root_seen) {
+                    throw std::runtime_error("malformed XML");
+                }
+                sc = scene(tag.IntAttribute("width"), tag.IntAttribute("height"));
+                root_seen = true;
+                open.push_back({ matrix::identity(), 255, true });
+            } else if (!open.back().container) {
+                open.push_back(open.back());
+            } else if (::strcmp(tag.Name(), "use") == 0) {
+                throw needs_dom();
+            } else if (::strcmp(tag.Name(), "g") == 0) {
+                open.push_back({ open.back().transform * parse_transform(&tag),
+                                 multiply_alpha(open.back().opacity,
+                                                parse_opacity(tag.Attribute("opacity"))),
+                                 true });
+            } else {
+                shape *s = parse_shape(&tag, ctx, open.back().opacity);
+                if (s != NULL) {
+                    matrix m = open.back().transform * parse_transform(&tag);
+                    if (!m.is_identity())
+                        s->transform(m);
+                    s->record(sc);
+                    ctx.shapes.reset();
+                    ctx.points.reset();
+                }
+                open.push_back({ open.back().transform, open.back().opacity, false });
+            }
+        }
+        if (!root_seen || depth != 0) {
+            throw std::runtime_error("malformed XML");
         }
     }
 
+    // Documents that the streaming parser cannot load are loaded
+    // with the DOM instead.
+    scene::scene(const std::string &svg_file, bool streaming) {
+        if (streaming) {
+            try {
+                mapped_file file(svg_file);
+                load_stream(file.data(), file.size(), *this);
+                return;
+            } catch (const needs_dom &) {
+            } catch (const std::runtime_error &) {
+                throw std::runtime_error(svg_file + ": could not load SVG file!");
+            }
+        }
+        XMLDocument doc;
+        if (doc.LoadFile(svg_file.c_str()) != XML_SUCCESS) {
+            throw std::runtime_error(svg_file + ": could not load SVG file!");
+        }
+        load_dom(doc, *this);
+    }
+
+    scene scene::parse(const std::string &svg_text, bool streaming) {
+        scene sc(0, 0);
+        if (streaming) {
+            try {
+                load_stream(svg_text.data(), svg_text.size(), sc);
+                return sc;
+            } catch (const needs_dom &) {
+            } catch (const std::runtime_error &) {
+                throw std::runtime_error("could not parse SVG text!");
+            }
+        }
+        XMLDocument doc;
+        if (doc.Parse(svg_text.data(), svg_text.size()) != XML_SUCCESS ||
+            doc.RootElement() == NULL) {
+            throw std::runtime_error("could not parse SVG text!");
+        }
+        load_dom(doc, sc);
+        return sc;
+    }
+
+    png_image render(const std::string &svg_file, const render_options &options,
+                     render_stats *stats) {
+        scene sc(svg_file, options.streaming);
+        png_image img(sc.width(), sc.height(), options.layout);
+        sc.render(img, options, stats);
+        return img;
+    }
+
+    png_image render_text(const std::string &svg_text, const render_options &options,
+                          render_stats *stats) {
+        scene sc = scene::parse(svg_text, options.streaming);
+        png_image img(sc.width(), sc.height(), options.layout);
+        sc.render(img, options, stats);
+        return img;
+    }
+
+    // Main conversion function.
+    // TODO adapt if necessary
+    void svg_to_png(const std::string &svg_file, const std::string &png_file,
+                    const render_options &options, render_stats *stats,
+                    const png_options &encoding) {
+        render(svg_file, options, stats).save(png_file, encoding);
+    }
+
 }
@@ -1,15 +1,41 @@
-
 //! @file svg_to_png.hpp
 #ifndef __svg_svg_to_png_hpp__
 #define __svg_svg_to_png_hpp__
 
 #include <fstream>
+#include "scene.hpp"
 
 namespace svg {
+    //! Render an SVG file, without saving the image.
+    //! Throws std::runtime_error if the SVG file cannot be loaded.
+    //! @param svg_file Name of SVG file.
+    //! @param options Rendering options.
+    //! @param stats If not NULL, filled with rendering statistics.
+    //! @return Rendered image.
+    png_image render(const std::string &svg_file,
+                     const render_options &options = render_options(),
+                     render_stats *stats = NULL);
+    //! Render an SVG document held in memory.
+    //! Throws std::runtime_error if the text cannot be parsed.
+    //! @param svg_text SVG document.
+    //! @param options Rendering options.
+    //! @param stats If not NULL, filled with rendering statistics.
+    //! @return Rendered image.
+    png_image render_text(const std::string &svg_text,
+                          const render_options &options = render_options(),
+                          render_stats *stats = NULL);
     //! Convert SVG file to PNG file.
+    //! Throws std::runtime_error if the SVG file cannot be loaded
+    //! or the PNG file cannot be written.
     //! @param svg_file Name of SVG file.
     //! param png_file Name of PNG file.
+    //! @param options Rendering options.
+    //! @param stats If not NULL, filled with rendering statistics.
+    //! @param encoding PNG encoding options.
     void
-    svg_to_png(const std::string &svg_file, const std::string &png_file);
+    svg_to_png(const std::string &svg_file, const std::string &png_file,
+               const render_options &options = render_options(),
+               render_stats *stats = NULL,
+               const png_options &encoding = png_options());
 }
 #endif
@@ -0,0 +1,242 @@
+#include "xml_stream.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace svg {
+    mapped_file::mapped_file(const std::string& file_name) {
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(file_name + ": could not open file!");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error(file_name + ": could not open file!");
+        }
+        file_size = (size_t) st.st_size;
+        file_data = NULL;
+        if (file_size > 0) {
+            void* p = ::mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error(file_name + ": could not map file!");
+            }
+            ::madvise(p, file_size, MADV_SEQUENTIAL);
+            file_data = (const char*) p;
+        }
+        ::close(fd);
+    }
+
+    mapped_file::~mapped_file() {
+        if (file_data != NULL) {
+            ::munmap((void*) file_data, file_size);
+        }
+    }
+
+    const char* mapped_file::data() const {
+        return file_data;
+    }
+    size_t mapped_file::size() const {
+        return file_size;
+    }
+
+    const char* xml_tag::Name() const {
+        return text.data();
+    }
+
+    const char* xml_tag::Attribute(const char* name) const {
+        for (auto& a : attributes) {
+            if (::strcmp(text.data() + a.first, name) == 0) {
+                return text.data() + a.second;
+            }
+        }
+        return NULL;
+    }
+
+    int xml_tag::IntAttribute(const char* name, int default_value) const {
+        const char* v = Attribute(name);
+        if (v == NULL) {
+            return default_value;
+        }
+        char* v_end;
+        long r = ::strtol(v, &v_end, 10);
+        return v_end == v ? default_value : (int) r;
+    }
+
+    namespace {
+        bool is_space(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+        bool is_name_end(char c) {
+            return is_space(c) || c == '=' || c == '/' || c == '>';
+        }
+        // Append text to buffer, decoding the predefined XML entities.
+        void append_text(std::vector<char>& buf, const char* from, const char* to) {
+            static const struct {
+                const char* name;
+                size_t len;
+                char c;
+            } entities[] = {
+                    {"&lt;",   4, '<'},
+                    {"&gt;",   4, '>'},
+                    {"&amp;",  5, '&'},
+                    {"&quot;", 6, '"'},
+                    {"&apos;", 6, '\''}
+            };
+            while (from < to) {
+                const char* amp = (const char*) ::memchr(from, '&', to - from);
+                if (amp == NULL) {
+                    amp = to;
+                }
+                buf.insert(buf.end(), from, amp);
+                from = amp;
+                if (from < to) {
+                    bool decoded = false;
+                    for (auto& e : entities) {
+                        if ((size_t) (to - from) >= e.len &&
+                            ::strncmp(from, e.name, e.len) == 0) {
+                            buf.push_back(e.c);
+                            from += e.len;
+                            decoded = true;
+                            break;
+                        }
+                    }
+                    if (!decoded) {
+                        buf.push_back(*from++);
+                    }
+                }
+            }
+            buf.push_back('\0');
+        }
+    }
+
+    xml_reader::xml_reader(const char* data, size_t size) :
+            pos(data), end(data + size), pending_end(false) {
+
+    }
+
+    void xml_reader::error() const {
+        throw std::runtime_error("malformed XML");
+    }
+
+    void xml_reader::skip_past(const char* terminator) {
+        size_t len = ::strlen(terminator);
+        for (;;) {
+            const char* p = (const char*) ::memchr(pos, terminator[0], end - pos);
+            if (p == NULL || (size_t) (end - p) < len) {
+                error();
+            }
+            if (::memcmp(p, terminator, len) == 0) {
+                pos = p + len;
+                return;
+            }
+            pos = p + 1;
+        }
+    }
+
+    xml_reader::event xml_reader::next(xml_tag& tag) {
+        if (pending_end) {
+            pending_end = false;
+            return END;
+        }
+        for (;;) {
+            const char* lt = (const char*) ::memchr(pos, '<', end - pos);
+            if (lt == NULL) {
+                pos = end;
+                return DONE;
+            }
+            pos = lt + 1;
+            if (pos >= end) {
+                error();
+            }
+            if (*pos == '?') {
+                skip_past("?>");
+            } else if (end - pos >= 3 && ::memcmp(pos, "!--", 3) == 0) {
+                pos += 3;
+                skip_past("-->");
+            } else if (end - pos >= 8 && ::memcmp(pos, "![CDATA[", 8) == 0) {
+                pos += 8;
+                skip_past("]]>");
+            } else if (*pos == '!') {
+                skip_past(">");
+            } else if (*pos == '/') {
+                skip_past(">");
+                return END;
+            } else {
+                break;
+            }
+        }
+
+        // Start tag: name, then attributes up to '>' or '/>'.
+        tag.text.clear();
+        tag.attributes.clear();
+        const char* name = pos;
+        while (pos < end && !is_name_end(*pos)) {
+            pos++;
+        }
+        if (pos == name) {
+            error();
+        }
+        tag.text.insert(tag.text.end(), name, pos);
+        tag.text.push_back('\0');
+        for (;;) {
+            while (pos < end && is_space(*pos)) {
+                pos++;
+            }
+            if (pos >= end) {
+                error();
+            }
+            if (*pos == '>') {
+                pos++;
+                return START;
+            }
+            if (*pos == '/') {
+                if (end - pos < 2 || pos[1] != '>') {
+                    error();
+                }
+                pos += 2;
+                pending_end = true;
+                return START;
+            }
+            const char* attr = pos;
+            while (pos < end && !is_name_end(*pos)) {
+                pos++;
+            }
+            if (pos == attr) {
+                error();
+            }
+            size_t name_offset = tag.text.size();
+            tag.text.insert(tag.text.end(), attr, pos);
+            tag.text.push_back('\0');
+            while (pos < end && is_space(*pos)) {
+                pos++;
+            }
+            if (pos >= end || *pos != '=') {
+                error();
+            }
+            pos++;
+            while (pos < end && is_space(*pos)) {
+                pos++;
+            }
+            if (pos >= end || (*pos != '"' && *pos != '\'')) {
+                error();
+            }
+            char quote = *pos++;
+            const char* value = pos;
+            const char* value_end = (const char*) ::memchr(pos, quote, end - pos);
+            if (value_end == NULL) {
+                error();
+            }
+            tag.attributes.push_back({ name_offset, tag.text.size() });
+            append_text(tag.text, value, value_end);
+            pos = value_end + 1;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+//! @file xml_stream.hpp
+#ifndef __svg_xml_stream_hpp__
+#define __svg_xml_stream_hpp__
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace svg {
+    //! Read-only memory mapping of a file.
+    class mapped_file {
+    private:
+        //! File contents.
+        const char* file_data;
+        //! File size.
+        size_t file_size;
+    public:
+        //! Constructor.
+        //! Throws std::runtime_error if the file cannot be mapped.
+        //! @param file_name File name.
+        mapped_file(const std::string& file_name);
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        //! Destructor.
+        ~mapped_file();
+        //! Get file contents.
+        //! @return Pointer to first byte.
+        const char* data() const;
+        //! Get file size.
+        //! @return Size in bytes.
+        size_t size() const;
+    };
+
+    //! Element start tag read by xml_reader.
+    //! Provides the part of the tinyxml2::XMLElement interface used
+    //! by the SVG parser, so that parsing code works on both.
+    class xml_tag {
+        friend class xml_reader;
+    private:
+        //! Element name and attribute names and values, NUL-terminated.
+        std::vector<char> text;
+        //! Offsets in text of the name and value of each attribute.
+        std::vector<std::pair<size_t, size_t>> attributes;
+    public:
+        //! Get element name.
+        //! @return Element name.
+        const char* Name() const;
+        //! Get attribute value.
+        //! @param name Attribute name.
+        //! @return Attribute value, or NULL if not defined.
+        const char* Attribute(const char* name) const;
+        //! Get attribute value as an integer.
+        //! @param name Attribute name.
+        //! @param default_value Value if not defined or not an integer.
+        //! @return Attribute value.
+        int IntAttribute(const char* name, int default_value = 0) const;
+    };
+
+    //! Streaming XML reader.
+    //! Walks a buffer once, reporting element start and end tags
+    //! (a self-closing tag gives a start and then an end event).
+    //! Text, comments, processing instructions, CDATA sections and
+    //! DOCTYPE declarations are skipped.
+    class xml_reader {
+    private:
+        //! Current position.
+        const char* pos;
+        //! End of buffer.
+        const char* end;
+        //! Whether an end event is due for a self-closing tag.
+        bool pending_end;
+        //! Skip past the given terminator.
+        void skip_past(const char* terminator);
+        //! Throw error for malformed input.
+        void error() const;
+    public:
+        //! Reader event.
+        enum event {
+            START,
+            END,
+            DONE
+        };
+        //! Constructor.
+        //! @param data Buffer with XML text.
+        //! @param size Buffer size.
+        xml_reader(const char* data, size_t size);
+        //! Read next event.
+        //! Throws std::runtime_error on malformed input.
+        //! @param tag Filled with the tag for START events.
+        //! @return Event.
+        event next(xml_tag& tag);
+    };
+}
+#endif
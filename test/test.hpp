@@ -1,6 +1,8 @@
 #ifndef __test_hpp__
 #define __test_hpp__
 
+#include <cstdio>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <svg/svg.hpp>
 
@@ -8,19 +10,51 @@ using namespace svg;
 const std::string root_path = ROOT_PROJ_DIR;
 
 
-void svg_test(std::string id) {
+void image_test(const png_image& e_img, const png_image& o_img) {
+    ASSERT_EQ(e_img.width(), o_img.width()) << " - different width!";
+    ASSERT_EQ(e_img.height(), o_img.height()) << " - different height!";
+    size_t n = (size_t) e_img.width() * e_img.height();
+    if (e_img.layout() == o_img.layout() &&
+        ::memcmp(e_img.data(), o_img.data(), n * e_img.pixel_size()) == 0) {
+        return;
+    }
+    for (int y = 0; y < e_img.height(); y++) {
+        for (int x = 0; x < e_img.width(); x++) {
+            const color& e = e_img.at(x, y);
+            const color& o = o_img.at(x, y);
+            if (e != o) {
+                FAIL() << " pixel " << x << ',' << y
+                       << ": expected rgb(" << (int) e.red << ',' << (int) e.green
+                       << ',' << (int) e.blue << "), got rgb(" << (int) o.red
+                       << ',' << (int) o.green << ',' << (int) o.blue << ")";
+            }
+        }
+    }
+}
+
+// Save an image to a temporary file (named name) and load it back.
+// The file is removed, so that tests leave no output behind.
+png_image save_and_load(const png_image& img, const std::string& name,
+                        const png_options& options = png_options()) {
+    std::string path = ::testing::TempDir() + name;
+    img.save(path, options);
+    png_image loaded(path);
+    std::remove(path.c_str());
+    return loaded;
+}
+
+// Render an SVG file in memory and compare it with the expected image.
+// The output is saved (to data/output) only if they differ.
+void svg_test(std::string id,
+              const render_options& options = render_options()) {
     std::string input = root_path + "/input/" + id + ".svg";
     std::string output = root_path + "/output/" + id + ".png";
     std::string expected = root_path + "/expected/" + id + ".png";
-    svg_to_png(input, output);
+    png_image o_img = render(input, options);
     png_image e_img(expected);
-    png_image o_img(output);
-    ASSERT_EQ(e_img.width(), o_img.width()) << " - different width!";
-    ASSERT_EQ(e_img.height(), o_img.height()) << " - different height!";
-    for (int x = 0; x < e_img.width(); x++) {
-        for (int y = 0; y < e_img.height(); y++) {
-            ASSERT_EQ(e_img.at(x, y), o_img.at(x, y)) << " pixel " << x << ',' << y;
-        }
+    image_test(e_img, o_img);
+    if (::testing::Test::HasFailure()) {
+        o_img.save(output);
     }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "test.hpp"
+
+// Anti-aliased rendering of lion.svg in one pass.
+png_image render_lion(const render_options& options) {
+    return render(root_path + "/input/lion.svg", options);
+}
+
+TEST(test, antialias_rect) {
+    // Axis-aligned edges cover whole pixels: same as aliased rendering.
+    render_options options;
+    options.antialias = true;
+    svg_test("rect_1", options);
+}
+TEST(test, antialias_tiles_rgbx) {
+    render_options options;
+    options.antialias = true;
+    png_image one = render_lion(options);
+    options.threads = 4;
+    options.tile_size = 32;
+    image_test(one, render_lion(options));
+    options.layout = LAYOUT_RGBX;
+    image_test(one, render_lion(options));
+}
+TEST(test, antialias_edge_coverage) {
+    // Grown by half a pixel, the hypotenuse is x + y = 31 + sqrt(2) / 2
+    // in pixel corner coordinates: pixels with x + y = 30 are 95.7%
+    // covered, those with x + y = 31 are 25% covered.
+    png_image img(40, 40);
+    point p[] = { { 0, 0 }, { 30, 0 }, { 0, 30 } };
+    img.draw_polygon_aa(p, 3, { 0, 0, 0 });
+    for (int x = 5; x <= 25; x++) {
+        ASSERT_EQ(0, img.at(x, 29 - x).red) << " pixel " << x;
+        ASSERT_NEAR(11, img.at(x, 30 - x).red, 2) << " pixel " << x;
+        ASSERT_NEAR(191, img.at(x, 31 - x).red, 2) << " pixel " << x;
+        ASSERT_EQ(255, img.at(x, 32 - x).red) << " pixel " << x;
+    }
+}
+TEST(test, antialias_translucent) {
+    // Whole pixels again, blended like aliased shapes.
+    png_image aliased(40, 30), aa(40, 30);
+    point p[] = { { 3, 2 }, { 35, 2 }, { 35, 20 }, { 3, 20 } };
+    point line[] = { { 1, 25 }, { 38, 25 } };
+    aliased.draw_polygon(p, 4, { 200, 10, 90 }, 100);
+    aliased.draw_polyline(line, 2, { 10, 200, 90 }, 100);
+    aa.draw_polygon_aa(p, 4, { 200, 10, 90 }, 100);
+    aa.draw_polyline_aa(line, 2, { 10, 200, 90 }, 100);
+    image_test(aliased, aa);
+}
+TEST(test, antialias_ellipse) {
+    // Total coverage is the area of the ellipse grown by half a pixel.
+    png_image img(60, 60);
+    img.draw_ellipse_aa({ 30, 30 }, { 20, 12 }, { 0, 0, 0 });
+    double area = 0;
+    for (int y = 0; y < 60; y++) {
+        for (int x = 0; x < 60; x++) {
+            area += (255 - img.at(x, y).red) / 255.0;
+        }
+    }
+    ASSERT_NEAR(M_PI * 20.5 * 12.5, area, 1);
+    ASSERT_EQ(0, img.at(30, 30).red);
+    ASSERT_EQ(0, img.at(11, 30).red);
+    ASSERT_NEAR(0, img.at(10, 30).red, 5);
+    ASSERT_EQ(255, img.at(8, 30).red);
+}
+TEST(test, antialias_slit) {
+    // The edges along y = 5 go to x = 5 and back: the aliased rasterizer
+    // paints them, and the grown polygon covers them twice.
+    png_image aliased(30, 20), aa(30, 20);
+    point p[] = { { 0, 0 }, { 20, 0 }, { 20, 5 }, { 5, 5 }, { 20, 5 }, { 20, 12 }, { 0, 12 } };
+    aliased.draw_polygon(p, 7, { 0, 0, 0 });
+    aa.draw_polygon_aa(p, 7, { 0, 0, 0 });
+    for (int x = 0; x <= 20; x++) {
+        ASSERT_EQ(0, aliased.at(x, 5).red) << " pixel " << x;
+        ASSERT_EQ(0, aa.at(x, 5).red) << " pixel " << x;
+    }
+    image_test(aliased, aa);
+}
+TEST(test, antialias_even_odd) {
+    // The center of the star is outside with the even-odd rule, but its
+    // edges are covered like those of other polygons.
+    png_image aliased(40, 40), aa(40, 40);
+    point p[] = { { 20, 2 }, { 31, 36 }, { 2, 14 }, { 38, 14 }, { 9, 36 } };
+    aliased.draw_polygon(p, 5, { 0, 0, 0 });
+    aa.draw_polygon_aa(p, 5, { 0, 0, 0 });
+    ASSERT_EQ(255, aliased.at(20, 20).red);
+    ASSERT_EQ(255, aa.at(20, 20).red);
+    for (int y = 0; y < 40; y++) {
+        for (int x = 0; x < 40; x++) {
+            if (aliased.at(x, y).red == 0) {
+                ASSERT_GE(128, aa.at(x, y).red) << " pixel " << x << ", " << y;
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#include "test.hpp"
+#include <svg/arena.hpp>
+
+// Allocate arrays of 1 to 7 points, with a polygon after each,
+// write a distinct value into every point, then check all of them:
+// arrays (also across block boundaries) do not overlap.
+void fill_and_check(arena &mem, int n, int tag) {
+    std::vector<point *> arrays;
+    for (int i = 0; i < n; i++) {
+        size_t len = 1 + i % 7;
+        point *p = mem.make_array<point>(len);
+        arrays.push_back(p);
+        mem.make<polygon>(color{0, 0, 0}, p, len);
+        for (size_t k = 0; k < len; k++) {
+            p[k] = { i, (int) k + tag };
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        size_t len = 1 + i % 7;
+        for (size_t k = 0; k < len; k++) {
+            ASSERT_EQ(i, arrays[i][k].x) << " array " << i;
+            ASSERT_EQ((int) k + tag, arrays[i][k].y) << " array " << i;
+        }
+    }
+}
+
+TEST(test, arena_few_blocks) {
+    arena mem;
+    fill_and_check(mem, 100000, 0);
+    ASSERT_LT(mem.block_count(), 16U);
+}
+
+TEST(test, arena_reset) {
+    arena mem(256);
+    fill_and_check(mem, 10000, 0);
+    ASSERT_GT(mem.block_count(), 1U);
+    mem.reset();
+    ASSERT_EQ(1U, mem.block_count());
+    // Memory handed out again after a reset.
+    fill_and_check(mem, 10000, 100);
+}
+
+struct counted {
+    int &count;
+    counted(int &count) : count(count) { }
+    ~counted() { count++; }
+};
+
+TEST(test, arena_destroys_objects) {
+    int count = 0;
+    {
+        arena mem(256);
+        for (int i = 0; i < 1000; i++) {
+            mem.make<counted>(count);
+        }
+    }
+    ASSERT_EQ(count, 1000);
+}
+
+TEST(test, arena_reset_destroys_objects) {
+    int count = 0;
+    arena mem(256);
+    for (int i = 0; i < 1000; i++) {
+        mem.make<counted>(count);
+    }
+    mem.reset();
+    ASSERT_EQ(count, 1000);
+    mem.make<counted>(count);
+    mem.reset();
+    ASSERT_EQ(count, 1001);
+}
@@ -0,0 +1,11 @@
+#include "test.hpp"
+
+TEST(test, clip_1) {
+    svg_test("clip_1");
+}
+TEST(test, clip_1_parallel) {
+    render_options options;
+    options.threads = 4;
+    options.tile_size = 32;
+    svg_test("clip_1", options);
+}
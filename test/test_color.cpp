@@ -0,0 +1,23 @@
+#include "test.hpp"
+#include <svg/color_parser.hpp>
+
+TEST(test, color_names) {
+    ASSERT_EQ(parse_color("black"), (color{0, 0, 0}));
+    ASSERT_EQ(parse_color("red"), (color{255, 0, 0}));
+    ASSERT_EQ(parse_color("green"), (color{0, 255, 0}));
+    ASSERT_EQ(parse_color("cornflowerblue"), (color{100, 149, 237}));
+    ASSERT_EQ(parse_color("LightGoldenRodYellow"), (color{250, 250, 210}));
+    ASSERT_EQ(parse_color(" teal "), (color{0, 128, 128}));
+}
+TEST(test, color_hex) {
+    ASSERT_EQ(parse_color("#000000"), (color{0, 0, 0}));
+    ASSERT_EQ(parse_color("#1a2B3c"), (color{0x1a, 0x2b, 0x3c}));
+    ASSERT_EQ(parse_color("#f80"), (color{0xff, 0x88, 0x00}));
+}
+TEST(test, color_invalid) {
+    ASSERT_THROW(parse_color(""), std::runtime_error);
+    ASSERT_THROW(parse_color("notacolor"), std::runtime_error);
+    ASSERT_THROW(parse_color("redd"), std::runtime_error);
+    ASSERT_THROW(parse_color("#12345"), std::runtime_error);
+    ASSERT_THROW(parse_color("#12g"), std::runtime_error);
+}
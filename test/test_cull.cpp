@@ -0,0 +1,19 @@
+#include "test.hpp"
+
+void cull_test(std::string id, size_t expected_culled) {
+    std::string input = root_path + "/input/" + id + ".svg";
+    render_stats stats;
+    render(input, render_options(), &stats);
+    ASSERT_EQ(expected_culled, stats.culled) << " - wrong number of culled shapes!";
+    svg_test(id);
+}
+
+TEST(test, cull_1) {
+    cull_test("cull_1", 3);
+}
+TEST(test, cull_2) {
+    cull_test("cull_2", 2);
+}
+TEST(test, cull_lion) {
+    cull_test("lion", 0);
+}
@@ -12,3 +12,15 @@ TEST(test, circle_1) {
 TEST(test, circle_2) {
     svg_test("circle_2");
 }
+TEST(test, ellipse_clipped_rows) {
+    // Rows below the top of the image are the same as in a whole ellipse.
+    png_image whole(101, 101), part(101, 40);
+    whole.draw_ellipse({ 50, 50 }, { 47, 31 }, { 0, 0, 255 });
+    part.draw_ellipse({ 50, -10 }, { 47, 31 }, { 0, 0, 255 });
+    for (int y = 0; y < 40; y++) {
+        for (int x = 0; x < 101; x++) {
+            ASSERT_EQ(whole.at(x, y + 60).blue, part.at(x, y).blue);
+            ASSERT_EQ(whole.at(x, y + 60).red, part.at(x, y).red);
+        }
+    }
+}
@@ -18,3 +18,33 @@ TEST(test, group_5) {
 TEST(test, group_6) {
     svg_test("group_6");
 }
+TEST(test, group_7) {
+    svg_test("group_7");
+}
+
+// Every pixel drawn by a group or instance lies in its bounds, even when
+// a rotation keeps an ellipse axis-aligned with swapped radii.
+void bounds_test(const shape &s) {
+    png_image img(100, 100);
+    s.draw(img);
+    box b = s.bounds();
+    for (int y = 0; y < img.height(); y++)
+        for (int x = 0; x < img.width(); x++)
+            if (img.at(x, y) != color{ 255, 255, 255 }) {
+                ASSERT_TRUE(x >= b.x_min && x <= b.x_max &&
+                            y >= b.y_min && y <= b.y_max)
+                    << " pixel " << x << ',' << y << " out of bounds";
+            }
+}
+TEST(test, group_bounds_rotated_ellipse) {
+    ellipse e({ 255, 0, 0 }, { 50, 50 }, { 20, 5 });
+    group g({ &e });
+    g.transform(matrix::rotation(90).around({ 50, 50 }));
+    box b = g.bounds();
+    EXPECT_EQ(40, b.x_max - b.x_min);
+    EXPECT_EQ(10, b.y_max - b.y_min);
+    bounds_test(g);
+    use u(&g);
+    u.transform(matrix::rotation(30).around({ 50, 50 }));
+    bounds_test(u);
+}
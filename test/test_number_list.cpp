@@ -0,0 +1,40 @@
+#include "test.hpp"
+#include <svg/number_list.hpp>
+
+TEST(test, number_list_separators) {
+    const char *s = " 1,2 3 , 4\n-5,+6,,7 8";
+    ASSERT_EQ(count_numbers(s), 8U);
+    point p[4];
+    parse_points(s, p, 4);
+    ASSERT_EQ(p[0].x, 1);
+    ASSERT_EQ(p[0].y, 2);
+    ASSERT_EQ(p[1].x, 3);
+    ASSERT_EQ(p[1].y, 4);
+    ASSERT_EQ(p[2].x, -5);
+    ASSERT_EQ(p[2].y, 6);
+    ASSERT_EQ(p[3].x, 7);
+    ASSERT_EQ(p[3].y, 8);
+}
+TEST(test, number_list_rounding) {
+    const char *s = "1.5 -1.5 2.49 .7 -0.2 1e2 2.5e-1 10-3";
+    int expected[] = { 2, -2, 2, 1, 0, 100, 0, 10, -3 };
+    ASSERT_EQ(count_numbers(s), 9U);
+    for (int e : expected) {
+        int v;
+        ASSERT_TRUE(parse_number(s, v));
+        ASSERT_EQ(v, e);
+    }
+    int v;
+    ASSERT_FALSE(parse_number(s, v));
+}
+TEST(test, number_list_fractions) {
+    const char *s = "0.5,-1.25 .75 1e-2";
+    double expected[] = { 0.5, -1.25, 0.75, 0.01 };
+    for (double e : expected) {
+        double v;
+        ASSERT_TRUE(parse_number(s, v));
+        ASSERT_DOUBLE_EQ(v, e);
+    }
+    double v;
+    ASSERT_FALSE(parse_number(s, v));
+}
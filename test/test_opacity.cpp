@@ -0,0 +1,64 @@
+#include "test.hpp"
+#include <svg/color_parser.hpp>
+
+TEST(test, opacity_1) {
+    svg_test("opacity_1");
+}
+TEST(test, opacity_2) {
+    svg_test("opacity_2");
+}
+TEST(test, opacity_stream) {
+    render_options options;
+    options.streaming = true;
+    svg_test("opacity_1", options);
+}
+TEST(test, opacity_tiles_rgbx) {
+    render_options options;
+    options.threads = 4;
+    options.tile_size = 32;
+    options.layout = LAYOUT_RGBX;
+    svg_test("opacity_1", options);
+    svg_test("opacity_2", options);
+}
+TEST(test, opacity_parse) {
+    rgb_value alpha;
+    ASSERT_EQ(parse_color("#11223344", alpha), (color{0x11, 0x22, 0x33}));
+    ASSERT_EQ(0x44, alpha);
+    ASSERT_EQ(parse_color("#abc8", alpha), (color{0xaa, 0xbb, 0xcc}));
+    ASSERT_EQ(0x88, alpha);
+    parse_color("transparent", alpha);
+    ASSERT_EQ(0, alpha);
+    parse_color("red", alpha);
+    ASSERT_EQ(255, alpha);
+    ASSERT_EQ(128, parse_opacity("0.5"));
+    ASSERT_EQ(64, parse_opacity("25%"));
+    ASSERT_EQ(255, parse_opacity("3"));
+    ASSERT_EQ(0, parse_opacity("-1"));
+    ASSERT_EQ(255, parse_opacity(NULL));
+    ASSERT_THROW(parse_opacity("half"), std::runtime_error);
+}
+TEST(test, opacity_blend_span) {
+    // Spans of all lengths and phases, against exactly rounded blending.
+    for (pixel_layout layout : { LAYOUT_RGB, LAYOUT_RGBX }) {
+        png_image img(64, 256, layout);
+        color c = { 200, 100, 7 };
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 64; x++) {
+                img.at(x, y) = { (rgb_value) (x * 4), (rgb_value) y, (rgb_value) (255 - y) };
+            }
+            img.blend_span(y, y % 7, y % 7 + y % 50, c, (rgb_value) y);
+        }
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 64; x++) {
+                color e = { (rgb_value) (x * 4), (rgb_value) y, (rgb_value) (255 - y) };
+                if (x >= y % 7 && x <= y % 7 + y % 50) {
+                    auto mix = [&](int s, int d) {
+                        return (rgb_value) ((s * y + d * (255 - y) + 127) / 255);
+                    };
+                    e = { mix(c.red, e.red), mix(c.green, e.green), mix(c.blue, e.blue) };
+                }
+                ASSERT_EQ(e, img.at(x, y)) << " pixel " << x << ',' << y;
+            }
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#include "test.hpp"
+
+render_options parallel(int tile_size) {
+    render_options options;
+    options.threads = 4;
+    options.tile_size = tile_size;
+    return options;
+}
+
+TEST(test, parallel_ellipse_1) {
+    svg_test("ellipse_1", parallel(16));
+}
+TEST(test, parallel_polygon_2) {
+    svg_test("polygon_2", parallel(16));
+}
+TEST(test, parallel_polyline_3) {
+    svg_test("polyline_3", parallel(7));
+}
+TEST(test, parallel_rotate_rect) {
+    svg_test("rotate_rect", parallel(32));
+}
+TEST(test, parallel_batman) {
+    svg_test("batman", parallel(64));
+}
+TEST(test, parallel_lion) {
+    svg_test("lion", parallel(64));
+}
+TEST(test, parallel_bad_tile_size) {
+    ASSERT_THROW(render(root_path + "/input/ellipse_1.svg", parallel(0)),
+                 std::invalid_argument);
+    ASSERT_THROW(render(root_path + "/input/ellipse_1.svg", parallel(-8)),
+                 std::invalid_argument);
+}
@@ -0,0 +1,35 @@
+#include "test.hpp"
+
+// Save an image with the given options and check that it loads back
+// with the same pixels.
+void png_round_trip(const std::string& id, const png_options& options) {
+    png_image img(root_path + "/expected/" + id + ".png");
+    image_test(img, save_and_load(img, id + "_encoded.png", options));
+}
+
+TEST(test, png_levels) {
+    png_options options;
+    for (int level = 0; level <= 9; level += 3) {
+        options.level = level;
+        png_round_trip("lion", options);
+    }
+}
+TEST(test, png_filters) {
+    png_options options;
+    const char* names[] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+    for (const char* name : names) {
+        ASSERT_TRUE(parse_png_filter(name, options.filter));
+        png_round_trip("batman", options);
+    }
+    ASSERT_FALSE(parse_png_filter("fast", options.filter));
+}
+TEST(test, png_parallel) {
+    png_options options;
+    options.threads = 4;
+    png_round_trip("use_6", options);
+    options.level = 0;
+    png_round_trip("use_6", options);
+    options.level = 1;
+    options.filter = png_options::FILTER_NONE;
+    png_round_trip("use_6", options);
+}
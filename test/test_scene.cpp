@@ -0,0 +1,101 @@
+#include "test.hpp"
+
+TEST(test, scene_render_twice) {
+    scene sc(root_path + "/input/lion.svg");
+    png_image e_img(root_path + "/expected/lion.png");
+    png_image img1(sc.width(), sc.height());
+    sc.render(img1);
+    image_test(e_img, img1);
+    render_options options;
+    options.threads = 4;
+    png_image img2(sc.width(), sc.height());
+    sc.render(img2, options);
+    image_test(e_img, img2);
+}
+TEST(test, scene_render_smaller_image) {
+    scene sc(root_path + "/input/batman.svg");
+    png_image e_img(root_path + "/expected/batman.png");
+    png_image img(sc.width() / 2, sc.height() / 3);
+    sc.render(img);
+    for (int x = 0; x < img.width(); x++) {
+        for (int y = 0; y < img.height(); y++) {
+            ASSERT_EQ(e_img.at(x, y), img.at(x, y)) << " pixel " << x << ',' << y;
+        }
+    }
+}
+TEST(test, scene_load_failure) {
+    ASSERT_THROW(scene(root_path + "/input/no_such_file.svg"), std::runtime_error);
+}
+TEST(test, scene_render_changes) {
+    point square[] = { { 10, 10 }, { 29, 10 }, { 29, 29 }, { 10, 29 } };
+    point moved[] = { { 60, 60 }, { 79, 60 }, { 79, 79 }, { 60, 79 } };
+    color red = { 255, 0, 0 }, blue = { 0, 0, 255 };
+    scene old_sc(100, 100), new_sc(100, 100);
+    old_sc.add_ellipse(red, { 50, 50 }, { 40, 20 }, { 10, 30, 90, 70 }, { 0, 0, -1, -1 });
+    old_sc.add_polygon(blue, square, 4, { 10, 10, 29, 29 }, { 10, 10, 29, 29 });
+    new_sc.add_ellipse(red, { 50, 50 }, { 40, 20 }, { 10, 30, 90, 70 }, { 0, 0, -1, -1 });
+    new_sc.add_polygon(blue, moved, 4, { 60, 60, 79, 79 }, { 60, 60, 79, 79 });
+    png_image img(100, 100);
+    old_sc.render(img);
+    std::vector<box> areas = new_sc.render_changes(img, old_sc);
+    ASSERT_EQ(2u, areas.size());
+    png_image e_img(100, 100);
+    new_sc.render(e_img);
+    image_test(e_img, img);
+    ASSERT_TRUE(new_sc.changes(new_sc).empty());
+}
+TEST(test, scene_render_text) {
+    std::string svg = "<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">"
+                      "<circle cx=\"40\" cy=\"40\" r=\"30\" fill=\"red\"/>"
+                      "<circle cx=\"60\" cy=\"60\" r=\"30\" fill=\"blue\"/>"
+                      "</svg>";
+    png_image e_img(root_path + "/expected/group_1.png");
+    for (bool streaming : { false, true }) {
+        render_options options;
+        options.streaming = streaming;
+        image_test(e_img, render_text(svg, options));
+        ASSERT_THROW(render_text("<svg width=\"10\"", options), std::runtime_error);
+    }
+}
+TEST(test, scene_render_rgbx) {
+    render_options options;
+    options.layout = LAYOUT_RGBX;
+    for (const char* name : { "lion", "use_4", "group_7" }) {
+        png_image e_img(root_path + "/expected/" + name + ".png");
+        png_image img = render(root_path + "/input/" + name + ".svg", options);
+        ASSERT_EQ(LAYOUT_RGBX, img.layout());
+        ASSERT_EQ(4, img.pixel_size());
+        image_test(e_img, img);
+        image_test(e_img, save_and_load(img, std::string(name) + "_rgbx.png"));
+    }
+}
+TEST(test, scene_changes_far_apart) {
+    // Editing the first and the last polygons of lion.svg only
+    // repaints around them.
+    std::ifstream in(root_path + "/input/lion.svg");
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    scene old_sc = scene::parse(text);
+    text.replace(text.find("#FADFAA"), 7, "#000000");
+    text.replace(text.rfind("#682B58"), 7, "#FFFFFF");
+    scene new_sc = scene::parse(text);
+    std::vector<box> areas = new_sc.changes(old_sc);
+    ASSERT_EQ(2u, areas.size());
+    long long area = 0;
+    for (auto& b : areas) {
+        area += (long long) (b.x_max - b.x_min + 1) * (b.y_max - b.y_min + 1);
+    }
+    ASSERT_LT(area, 3000);
+    // Also by small tiles, which do not start at the corner of the areas.
+    render_options tiled, antialiased;
+    tiled.threads = 4;
+    tiled.tile_size = 7;
+    antialiased.antialias = true;
+    for (const render_options& options : { render_options(), tiled, antialiased }) {
+        png_image img(old_sc.width(), old_sc.height());
+        old_sc.render(img, options);
+        new_sc.render_changes(img, old_sc, options);
+        png_image e_img(new_sc.width(), new_sc.height());
+        new_sc.render(e_img, options);
+        image_test(e_img, img);
+    }
+}
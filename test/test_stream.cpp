@@ -0,0 +1,59 @@
+#include "test.hpp"
+
+render_options streaming() {
+    render_options options;
+    options.streaming = true;
+    return options;
+}
+
+TEST(test, stream_ellipse_1) {
+    svg_test("ellipse_1", streaming());
+}
+TEST(test, stream_polyline_3) {
+    svg_test("polyline_3", streaming());
+}
+TEST(test, stream_line_2) {
+    svg_test("line_2", streaming());
+}
+TEST(test, stream_rotate_rect_with_origin) {
+    svg_test("rotate_rect_with_origin", streaming());
+}
+TEST(test, stream_lion) {
+    svg_test("lion", streaming());
+}
+TEST(test, stream_load_failure) {
+    ASSERT_THROW(scene(root_path + "/input/no_such_file.svg", true),
+                 std::runtime_error);
+}
+TEST(test, stream_group_5) {
+    svg_test("group_5", streaming());
+}
+TEST(test, stream_group_6) {
+    svg_test("group_6", streaming());
+}
+TEST(test, stream_nested_fractional_transforms) {
+    // Shapes in groups are transformed once, by the composed matrix,
+    // in both modes.
+    std::string svg =
+        "<svg width='120' height='120' xmlns='http://www.w3.org/2000/svg'>"
+        "<g transform='scale(2)'>"
+        "<polygon points='1,1 7,1 7,7' fill='red' transform='scale(0.5)'/>"
+        "<polygon points='11,3 37,5 29,23' fill='green' transform='scale(0.5)'/>"
+        "</g>"
+        "<g transform='scale(3)'>"
+        "<rect x='10' y='1' width='7' height='5' fill='blue'"
+        " transform='translate(0.4,0.4)'/>"
+        "<g transform='rotate(17) translate(0.3 0.6)'>"
+        "<ellipse cx='19' cy='7' rx='3' ry='2' fill='black' transform='scale(1.3)'/>"
+        "<line x1='3' y1='25' x2='21' y2='27' stroke='black' transform='scale(0.7)'/>"
+        "</g></g>"
+        "</svg>";
+    image_test(render_text(svg), render_text(svg, streaming()));
+}
+TEST(test, stream_use) {
+    // Documents with <use> elements are loaded with the DOM.
+    for (auto id : { "use_1", "use_2", "use_3", "use_4", "use_5", "use_6",
+                     "opacity_2" }) {
+        svg_test(id, streaming());
+    }
+}
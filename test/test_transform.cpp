@@ -84,3 +84,69 @@ TEST(test, rotate_circle) {
 TEST(test, rotate_circle_with_origin) {
     svg_test("rotate_circle_with_origin");
 }
+TEST(test, transform_list) {
+    svg_test("transform_list");
+}
+TEST(test, rotation_exact) {
+    matrix r = matrix::rotation(90);
+    ASSERT_EQ(0, r.a);
+    ASSERT_EQ(1, r.b);
+    ASSERT_EQ(-1, r.c);
+    ASSERT_EQ(0, r.d);
+    ASSERT_EQ(0.5, matrix::rotation(30).b);
+    ASSERT_EQ(-1, matrix::rotation(-180).a);
+    ASSERT_EQ(matrix::rotation(45).a, matrix::rotation(405).a);
+}
+TEST(test, apply_points) {
+    // Same rounding as single points, halfway cases included.
+    matrix ms[] = { matrix::scaling(0.5, -0.5),
+                    matrix::rotation(37) * matrix::translation(0.5, -2.5),
+                    matrix::scaling(1.5, 2.5).around({ 7, -3 }),
+                    matrix::skew_x(20) * matrix::rotation(-123.25) };
+    std::vector<point> points;
+    for (int i = -50; i <= 50; i++) {
+        points.push_back({ i * 7 + 1, i * -3 });
+        points.push_back({ i, i * i });
+    }
+    points.push_back({ 123456, -654321 });
+    for (const matrix& m : ms) {
+        std::vector<point> batch(points);
+        m.apply(batch.data(), batch.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            point p = m.apply(points[i]);
+            ASSERT_EQ(p.x, batch[i].x) << " point " << i;
+            ASSERT_EQ(p.y, batch[i].y) << " point " << i;
+        }
+    }
+}
+TEST(test, transform_list_by_hand) {
+    // transform_list.svg with the transforms applied by hand.
+    png_image by_hand = render_text(
+        "<svg width='180' height='200' xmlns='http://www.w3.org/2000/svg'>"
+        "<polygon points='50,40 50,80 30,80' fill='red'/>"
+        "<circle cx='70' cy='70' r='15' fill='blue'/>"
+        "<polygon points='100,100 100,140 80,140 80,100' fill='green'/>"
+        "<polyline points='5,150 25,170 45,150' fill='none' stroke='black'/>"
+        "</svg>");
+    image_test(by_hand, render(root_path + "/input/transform_list.svg"));
+    image_test(by_hand, png_image(root_path + "/expected/transform_list.png"));
+}
+TEST(test, transform_list_no_drift) {
+    // Composed lists give the pixels of the single equivalent transform.
+    auto svg = [](const std::string& transform) {
+        return "<svg width='200' height='200' xmlns='http://www.w3.org/2000/svg'>"
+               "<polygon points='101,97 143,103 139,121 97,125' fill='red'"
+               " transform-origin='100 100' transform='" + transform + "'/>"
+               "<polyline points='3,7 41,19 77,3' stroke='black'"
+               " transform='" + transform + "'/>"
+               "<ellipse cx='33' cy='51' rx='7' ry='5' fill='blue'"
+               " transform='" + transform + "'/>"
+               "</svg>";
+    };
+    image_test(render_text(svg("rotate(90)")),
+               render_text(svg("rotate(30) rotate(30) rotate(30)")));
+    image_test(render_text(svg("matrix(2.5 0 0 1.5 7.25 -3.5)")),
+               render_text(svg("translate(7.25 -3.5) scale(2.5 1.5)")));
+    image_test(render_text(svg("matrix(0 2 -2 0 150 10)")),
+               render_text(svg("translate(150 10) rotate(90) scale(2)")));
+}
@@ -18,3 +18,53 @@ TEST(test, use_5) {
 TEST(test, use_6) {
     svg_test("use_6");
 }
+TEST(test, use_sprite_cache) {
+    std::string input = root_path + "/input/use_3.svg";
+    render_stats stats;
+    render(input, render_options(), &stats);
+    ASSERT_EQ(1u, stats.cached_sprites) << " - wrong number of cached sprites!";
+    render_options options;
+    options.threads = 4;
+    options.tile_size = 100;
+    svg_test("use_3", options);
+    options.sprite_cache = 0;
+    render(input, options, &stats);
+    ASSERT_EQ(0u, stats.cached_sprites) << " - sprite cache over budget!";
+    svg_test("use_3", options);
+    // Instances at negative offsets give the same pixels as when drawn.
+    std::string svg =
+        "<svg width='60' height='60' xmlns='http://www.w3.org/2000/svg'>"
+        "<polygon id='b' points='16,1 9,0 3,12 19,2 2,7' fill='red'/>"
+        "<use href='#b' x='-6' y='-4'/>"
+        "<use href='#b' x='44' y='8'/>"
+        "<use href='#b' x='-3' y='40'/>"
+        "</svg>";
+    png_image drawn = render_text(svg, options);
+    image_test(drawn, render_text(svg, render_options(), &stats));
+    ASSERT_EQ(1u, stats.cached_sprites);
+}
+TEST(test, use_nested_sprites_threads) {
+    // Sprite a holds an instance of sprite b: both are cached, and are
+    // rasterized by several threads at once.
+    std::string svg =
+        "<svg width='200' height='200' xmlns='http://www.w3.org/2000/svg'>"
+        "<polygon id='b' points='0,0 20,3 9,17' fill='red'/>"
+        "<use href='#b' x='5' y='5'/>"
+        "<use href='#b' x='150' y='10'/>"
+        "<g id='a'><rect x='0' y='0' width='30' height='8' fill='blue'/>"
+        "<use href='#b' x='4' y='10'/></g>"
+        "<use href='#a' x='40' y='60'/>"
+        "<use href='#a' x='120' y='140'/>"
+        "</svg>";
+    render_options options;
+    options.sprite_cache = 0;
+    png_image drawn = render_text(svg, options);
+    options.sprite_cache = render_options().sprite_cache;
+    options.threads = 8;
+    options.tile_size = 32;
+    for (int i = 0; i < 20; i++) {
+        render_stats stats;
+        image_test(drawn, render_text(svg, options, &stats));
+        ASSERT_EQ(2u, stats.cached_sprites);
+    }
+}